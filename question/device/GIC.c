@@ -7,8 +7,13 @@
 
 #include "GIC.h"
 
+#if defined( BOARD_PBX_A9 )
+GICC_t* GICC0 = ( GICC_t* )( 0x1F000100 );
+GICD_t* GICD0 = ( GICD_t* )( 0x1F001000 );
+#else
 GICC_t* GICC0 = ( GICC_t* )( 0x1E000000 );
 GICD_t* GICD0 = ( GICD_t* )( 0x1E001000 );
+#endif
 GICC_t* GICC1 = ( GICC_t* )( 0x1E010000 );
 GICD_t* GICD1 = ( GICD_t* )( 0x1E011000 );
 GICC_t* GICC2 = ( GICC_t* )( 0x1E020000 );
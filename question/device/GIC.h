@@ -52,7 +52,11 @@ typedef struct {
 typedef struct {
           RW uint32_t       CTLR;       // 0x0000          : control
           RO uint32_t      TYPER;       // 0x0004          : controller type
-          RO RSVD( 0, 0x0008, 0x00FC ); // 0x0008...0x00FC : reserved
+          RO RSVD( 0, 0x0008, 0x007C ); // 0x0008...0x007C : reserved
+          RW uint32_t    IGROUPR0;      // 0x0080          : group
+          RW uint32_t    IGROUPR1;      // 0x0084          : group
+          RW uint32_t    IGROUPR2;      // 0x0088          : group
+          RO RSVD( 10, 0x008C, 0x00FC ); // 0x008C...0x00FC : reserved
           RW uint32_t  ISENABLER0;      // 0x0100          :   set-enable
           RW uint32_t  ISENABLER1;      // 0x0104          :   set-enable
           RW uint32_t  ISENABLER2;      // 0x0108          :   set-enable
@@ -75,7 +79,7 @@ typedef struct {
           RO RSVD( 5, 0x030C, 0x03FC ); // 0x030C...0x03FC : reserved
           RW uint32_t IPRIORITYR[ 24 ]; // 0x0400...0x045C : priority
           RO RSVD( 6, 0x0460, 0x07FC ); // 0x0460...0x07FC : reserved
-          RO uint32_t  ITARGETSR[ 24 ]; // 0x0800...0x085C : processor target
+          RW uint32_t  ITARGETSR[ 24 ]; // 0x0800...0x085C : processor target
           RO RSVD( 7, 0x0860, 0x0BFC ); // 0x0760...0x0BFC : reserved
           RW uint32_t      ICFGR0;      // 0x0C00          : configuration
           RW uint32_t      ICFGR1;      // 0x0C04          : configuration
@@ -88,6 +92,9 @@ typedef struct {
           RO RSVD( 9, 0x0F04, 0x0FFC ); // 0x0F04...0x0FFC : reserved
 } GICD_t;
 
+#define GIC_SOURCE_SGI0   (  0 )
+#define GIC_SOURCE_SGI15  ( 15 )
+
 #define GIC_SOURCE_TIMER0 ( 36 )
 #define GIC_SOURCE_TIMER1 ( 37 )
 #define GIC_SOURCE_TIMER2 ( 73 )
@@ -107,6 +114,9 @@ typedef struct {
  * 
  * we know the registers are mapped to fixed addresses in memory, so we
  * can just define a (structured) pointer to each one to support access.
+ * On the (multi-core) realview-pbx-a9, GIC0 is instead the GIC within the
+ * Cortex-A9 MPCore private memory region: the interface is banked, i.e., 
+ * each core sees its own interface at the same address.
  */
 
 extern GICC_t* GICC0;
@@ -0,0 +1,209 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "proc.h"
+#include "host.h"
+
+/* This program measures the process management code natively, i.e., without
+ * QEMU.  Each benchmark is run for a number of trials, each of a number of
+ * operations, against a freshly booted process table; the time per operation
+ * (in nanoseconds) is then summarised over the trials by the mean, standard
+ * deviation, min, median, and the half-width of a 95% confidence interval
+ * for the mean.  The benchmarks are
+ *
+ * - schedule   n: invoke the scheduler, with n processes ready or executing,
+ * - fork_exit  n: fork, then terminate the child, with n processes,
+ * - pipe_fd    n: create then close a pipe, with n pipes open, and
+ * - pipe_rw    n: write then read n bytes via a pipe.
+ */
+
+#define BENCH_TRIALS ( 31 )
+#define BENCH_OPS    ( 10000 )
+
+ctx_t benchCtx; // context of the (notionally) executing process
+
+int benchTrials = BENCH_TRIALS;
+int benchOps    = BENCH_OPS;
+
+// reset the process table, start the console (as on reset), then fork until there are n processes
+
+void bench_boot( int n ) {
+  proc_init( 0 );
+  proc_spawn( 0, 0, hal_stack( 0 ) );
+
+  dispatch( &benchCtx, NULL, &procTab[ 0 ] );
+  procTab[ 0 ].status = STATUS_EXECUTING;
+
+  for( int i = 1; i < n; i++ ) {
+    proc_fork( &benchCtx );
+  }
+}
+
+// terminate process pid, per the kill system call
+
+void bench_reap( pid_t pid ) {
+  pcb_t* p = &procTab[ pid ];
+  cpu_t* cpu = rq_lock( p );
+
+  if( p->status == STATUS_READY ) {
+    rq_remove( cpu, p );
+  }
+
+  p->status = STATUS_TERMINATED;
+  spin_unlock( &cpu->lock );
+
+  for( int i = 0; i < MAX_FDS; i++ ) {
+    if( p->fdTab[ i ] >= 0 ) {
+      close_fd( p->fdTab[ i ], pid );
+    }
+  }
+
+  currentProcesses--;
+}
+
+// create a pipe, per the pipe system call
+
+void bench_pipe( int fd[ 2 ] ) {
+  pipe_t* p = pipe_alloc();
+
+  fd[ 0 ] = open_fd( p, RDONLY );
+  fd[ 1 ] = open_fd( p, WRONLY );
+}
+
+void bench_unpipe( int fd[ 2 ] ) {
+  close_fd( fd[ 0 ], executing->pid );
+  close_fd( fd[ 1 ], executing->pid );
+}
+
+double bench_schedule( int n ) {
+  bench_boot( n );
+
+  uint64_t t = host_ns();
+
+  for( int i = 0; i < benchOps; i++ ) {
+    schedule( &benchCtx );
+  }
+
+  return ( double )( host_ns() - t ) / benchOps;
+}
+
+double bench_fork_exit( int n ) {
+  bench_boot( n );
+
+  uint64_t t = host_ns();
+
+  for( int i = 0; i < benchOps; i++ ) {
+    bench_reap( proc_fork( &benchCtx ) );
+  }
+
+  return ( double )( host_ns() - t ) / benchOps;
+}
+
+double bench_pipe_fd( int n ) {
+  int fd[ 2 ], open[ MAX_FDS / 2 ][ 2 ];
+
+  bench_boot( 1 );
+
+  for( int i = 0; i < n; i++ ) {
+    bench_pipe( open[ i ] );
+  }
+
+  uint64_t t = host_ns();
+
+  for( int i = 0; i < benchOps; i++ ) {
+    bench_pipe( fd ); bench_unpipe( fd );
+  }
+
+  t = host_ns() - t;
+
+  for( int i = 0; i < n; i++ ) {
+    bench_unpipe( open[ i ] );
+  }
+
+  return ( double )( t ) / benchOps;
+}
+
+double bench_pipe_rw( int n ) {
+  int fd[ 2 ]; char x[ BUFFER_SIZE ] = { 0 };
+
+  bench_boot( 1 );
+  bench_pipe( fd );
+
+  pipe_t* p = openFileTab[ fd[ 0 ] ].file;
+
+  uint64_t t = host_ns();
+
+  for( int i = 0; i < benchOps; i++ ) {
+    pipe_write( p, x, n ); pipe_read( p, x, n );
+  }
+
+  t = host_ns() - t;
+
+  bench_unpipe( fd );
+
+  return ( double )( t ) / benchOps;
+}
+
+int bench_cmp( const void* x, const void* y ) {
+  double a = *( const double* )( x ), b = *( const double* )( y );
+
+  return ( a > b ) - ( a < b );
+}
+
+void bench_run( char* name, double ( *f )( int n ), int n ) {
+  double x[ benchTrials ], mean = 0, sd = 0;
+
+  for( int i = 0; i < benchTrials; i++ ) {
+    x[ i ] = f( n ); mean += x[ i ];
+  }
+
+  mean /= benchTrials;
+
+  for( int i = 0; i < benchTrials; i++ ) {
+    sd += ( x[ i ] - mean ) * ( x[ i ] - mean );
+  }
+
+  sd = ( benchTrials > 1 ) ? sqrt( sd / ( benchTrials - 1 ) ) : 0;
+
+  qsort( x, benchTrials, sizeof( double ), &bench_cmp );
+
+  printf( "%-10s %4d %10.1f %8.1f %10.1f %10.1f %8.1f\n", name, n, mean, sd, x[ 0 ], x[ benchTrials / 2 ], 1.96 * sd / sqrt( benchTrials ) );
+}
+
+int main( int argc, char* argv[] ) {
+  if( argc > 1 ) {
+    benchTrials = atoi( argv[ 1 ] );
+  }
+  if( argc > 2 ) {
+    benchOps    = atoi( argv[ 2 ] );
+  }
+
+  printf( "# %d trials of %d operations; ns per operation\n", benchTrials, benchOps );
+  printf( "# %-8s %4s %10s %8s %10s %10s %8s\n", "name", "n", "mean", "sd", "min", "median", "ci95" );
+
+  int procs[] = { 1, 2, 8, 32, MAX_PROCS - 1 };
+  int pipes[] = { 0, 16, ( MAX_FDS - 3 ) / 2 - 1 };
+  int bytes[] = { 1, BUFFER_SIZE };
+
+  for( int i = 0; i < sizeof( procs ) / sizeof( int ); i++ ) {
+    bench_run( "schedule",  &bench_schedule,  procs[ i ] );
+  }
+  for( int i = 0; i < sizeof( procs ) / sizeof( int ); i++ ) {
+    bench_run( "fork_exit", &bench_fork_exit, procs[ i ] );
+  }
+  for( int i = 0; i < sizeof( pipes ) / sizeof( int ); i++ ) {
+    bench_run( "pipe_fd",   &bench_pipe_fd,   pipes[ i ] );
+  }
+  for( int i = 0; i < sizeof( bytes ) / sizeof( int ); i++ ) {
+    bench_run( "pipe_rw",   &bench_pipe_rw,   bytes[ i ] );
+  }
+
+  return 0;
+}
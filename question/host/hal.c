@@ -0,0 +1,89 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include   "hal.h"
+#include   "smp.h"
+#include "trace.h"
+#include  "host.h"
+
+int      hostCpu   = 0;
+uint32_t hostKicks = 0;
+
+uint8_t  hostStack[ HOST_PROCS ][ HOST_STACK ] __attribute__ ( ( aligned( 8 ) ) );
+
+uint64_t host_ns() {
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+
+  return ( uint64_t )( ts.tv_sec ) * 1000000000ULL + ts.tv_nsec;
+}
+
+// smp.h
+
+int  cpu_id() {
+  return hostCpu;
+}
+
+void mem_barrier() {
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+void spin_lock   ( spinlock_t* x ) {
+  while( __atomic_exchange_n( x, 1, __ATOMIC_ACQUIRE ) ) {
+    // a single thread, so a held lock is an error in the kernel
+  }
+}
+
+bool spin_trylock( spinlock_t* x ) {
+  return !__atomic_exchange_n( x, 1, __ATOMIC_ACQUIRE );
+}
+
+void spin_unlock ( spinlock_t* x ) {
+  __atomic_store_n( x, 0, __ATOMIC_RELEASE );
+}
+
+// trace.h
+
+uint32_t traceMask = 0;
+
+void trace_init() {
+  return;
+}
+
+void trace( trace_type_t x, int pid, uint32_t a, uint32_t b ) {
+  return;
+}
+
+int  trace_drain( int n, bool f ) {
+  return 0;
+}
+
+// hal.h
+
+void hal_print( char* x, int n ) {
+  fwrite( x, 1, n, stdout );
+}
+
+uint32_t hal_counter() {
+  return ( uint32_t )( host_ns() * 3 / 125 ); // 24MHz
+}
+
+void hal_kick( int id ) {
+  hostKicks++;
+}
+
+void hal_wheel( bool f ) {
+  return;
+}
+
+uintptr_t hal_stack( int i ) {
+  return ( uintptr_t )( &hostStack[ i ][ HOST_STACK ] );
+}
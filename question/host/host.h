@@ -0,0 +1,33 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A native host build links the process management code (kernel/proc.c, and
+ * kernel/timer.c) against an implementation of the hardware abstraction
+ * layer in memory (see hal.c): there is a single thread, which acts as CPU
+ * hostCpu, the terminal is stdout, kicks and the timer wheel tick are only
+ * counted, and the trace is discarded.  Since the kernel has a global named
+ * time, proc.h cannot be included alongside <time.h>: the host clock is
+ * therefore read via host_ns.
+ */
+
+#define HOST_PROCS 128        // processes with a stack, which must be at least MAX_PROCS
+#define HOST_STACK 0x00002000 // bytes of stack per process
+
+extern int      hostCpu;
+extern uint32_t hostKicks;
+
+// read the host monotonic clock, in nanoseconds
+extern uint64_t host_ns();
+
+#endif
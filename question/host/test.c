@@ -0,0 +1,392 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include <stdio.h>
+
+#include "proc.h"
+#include "host.h"
+
+/* This program tests the process management code natively, i.e., without
+ * QEMU.  Each test runs against a freshly booted process table, and checks
+ *
+ * - rq:     run queue ordering (by class, then priority or virtual runtime,
+ *           then PID) and the virtual runtime a process is made ready with,
+ * - sched:  the status transitions made by make_ready and schedule,
+ * - pipe:   the pipe ring buffer when empty, full, and wrapped around,
+ * - fd:     open file table reference counts, and that a pipe is freed once
+ *           (and only once) neither end is open, and
+ * - fork:   which process table slots fork reuses.
+ *
+ * Each failed check is printed, and the exit status is non-zero iff. any
+ * check failed.  free is replaced by a version which records the pointer
+ * (rather than freeing it), so a test can check what was freed.
+ */
+
+#define TEST( x ) test_check( ( x ), #x, __LINE__ )
+
+#define TEST_FREES ( 256 )
+
+ctx_t testCtx; // context of the (notionally) executing process
+
+int   testChecks = 0;
+int   testFails  = 0;
+
+void* testFreed[ TEST_FREES ]; // pointers passed to free, since the last test_boot
+int   testFreedNum = 0;
+
+void free( void* x ) {
+  if( ( x != NULL ) && ( testFreedNum < TEST_FREES ) ) {
+    testFreed[ testFreedNum++ ] = x;
+  }
+}
+
+// count the number of times x was freed since the last test_boot
+
+int test_frees( void* x ) {
+  int n = 0;
+
+  for( int i = 0; i < testFreedNum; i++ ) {
+    n += ( testFreed[ i ] == x );
+  }
+
+  return n;
+}
+
+void test_check( bool x, char* s, int line ) {
+  testChecks++;
+
+  if( !x ) {
+    printf( "host/test.c:%d: failed: %s\n", line, s ); testFails++;
+  }
+}
+
+// reset the process table, start the console (as on reset), then fork until there are n processes
+
+void test_boot( int n ) {
+  proc_init( 0 );
+  proc_spawn( 0, 0, hal_stack( 0 ) );
+
+  dispatch( &testCtx, NULL, &procTab[ 0 ] );
+  procTab[ 0 ].status = STATUS_EXECUTING;
+
+  for( int i = 1; i < n; i++ ) {
+    proc_fork( &testCtx );
+  }
+
+  testFreedNum = 0;
+}
+
+// terminate process pid, per the kill system call
+
+void test_kill( pid_t pid ) {
+  pcb_t* p = &procTab[ pid ];
+  cpu_t* cpu = rq_lock( p );
+
+  if( p->status == STATUS_READY ) {
+    rq_remove( cpu, p );
+  }
+
+  p->status = STATUS_TERMINATED;
+  spin_unlock( &cpu->lock );
+
+  for( int i = 0; i < MAX_FDS; i++ ) {
+    if( p->fdTab[ i ] >= 0 ) {
+      close_fd( p->fdTab[ i ], pid );
+    }
+  }
+
+  currentProcesses--;
+}
+
+void test_rq() {
+  cpu_t* cpu = &cpus[ hostCpu ];
+
+  test_boot( 6 ); // console executing, plus 1...5 ready
+
+  uint64_t vruntime[ 6 ] = { 0, 500, 100, 300, 100, 200 };
+
+  for( int i = 1; i < 6; i++ ) {
+    rq_remove( cpu, &procTab[ i ] );
+    procTab[ i ].vruntime = vruntime[ i ];
+  }
+  for( int i = 5; i >= 1; i-- ) {
+    rq_insert( cpu, &procTab[ i ] );
+  }
+
+  TEST( cpu->readyNum == 5 );
+
+  // least virtual runtime first, with ties broken by PID
+  int order[ 5 ] = { 2, 4, 5, 3, 1 };
+
+  for( int i = 0; i < 5; i++ ) {
+    pcb_t* p = rq_first( cpu );
+
+    TEST( ( p != NULL ) && ( p->pid == order[ i ] ) );
+    if( p != NULL ) {
+      rq_remove( cpu, p );
+      TEST( p->rqIndex == -1 );
+    }
+  }
+
+  TEST( rq_first( cpu ) == NULL );
+
+  // removal from the middle of the heap keeps the order
+  for( int i = 1; i < 6; i++ ) {
+    rq_insert( cpu, &procTab[ i ] );
+  }
+
+  rq_remove( cpu, &procTab[ 5 ] );
+  TEST( rq_first( cpu )->pid == 2 ); rq_remove( cpu, &procTab[ 2 ] );
+  TEST( rq_first( cpu )->pid == 4 ); rq_remove( cpu, &procTab[ 4 ] );
+  TEST( rq_first( cpu )->pid == 3 ); rq_remove( cpu, &procTab[ 3 ] );
+  TEST( rq_first( cpu )->pid == 1 ); rq_remove( cpu, &procTab[ 1 ] );
+
+  // a real-time process precedes any normal one, and a higher priority a lower
+  rq_insert( cpu, &procTab[ 2 ] );
+  TEST( sched_set( &procTab[ 1 ], SCHED_FIFO, 10 ) == 0 );
+  TEST( sched_set( &procTab[ 3 ], SCHED_RR,   20 ) == 0 );
+  TEST( sched_set( &procTab[ 4 ], SCHED_RR,    0 ) == -1 );
+  rq_insert( cpu, &procTab[ 1 ] );
+  rq_insert( cpu, &procTab[ 3 ] );
+
+  TEST( rq_first( cpu )->pid == 3 ); rq_remove( cpu, &procTab[ 3 ] );
+  TEST( rq_first( cpu )->pid == 1 ); rq_remove( cpu, &procTab[ 1 ] );
+  TEST( rq_first( cpu )->pid == 2 ); rq_remove( cpu, &procTab[ 2 ] );
+
+  // a process is made ready with at least the minimum virtual runtime, less a credit iff. it has executed before
+  test_boot( 3 );
+
+  rq_remove( cpu, &procTab[ 1 ] ); procTab[ 1 ].status = STATUS_WAITING;
+  rq_remove( cpu, &procTab[ 2 ] ); procTab[ 2 ].status = STATUS_WAITING;
+
+  cpu->minVruntime      = 4 * SCHED_WAKE_CREDIT;
+  procTab[ 1 ].vruntime = 0; procTab[ 1 ].lastCpu = -1; // forked
+  procTab[ 2 ].vruntime = 0; procTab[ 2 ].lastCpu =  0; // woken
+
+  make_ready( &procTab[ 1 ], cpu );
+  make_ready( &procTab[ 2 ], cpu );
+
+  TEST( procTab[ 1 ].vruntime == 4 * SCHED_WAKE_CREDIT );
+  TEST( procTab[ 2 ].vruntime == 3 * SCHED_WAKE_CREDIT );
+  TEST( rq_first( cpu )->pid == 2 );
+
+  procTab[ 1 ].status = STATUS_WAITING; rq_remove( cpu, &procTab[ 1 ] );
+  procTab[ 1 ].vruntime = 5 * SCHED_WAKE_CREDIT;
+
+  make_ready( &procTab[ 1 ], cpu );
+
+  TEST( procTab[ 1 ].vruntime == 5 * SCHED_WAKE_CREDIT ); // not lowered
+}
+
+void test_sched() {
+  cpu_t* cpu = &cpus[ hostCpu ];
+
+  test_boot( 2 ); // console executing, child 1 ready
+
+  TEST( executing == &procTab[ 0 ] );
+  TEST( procTab[ 1 ].status == STATUS_READY );
+  TEST( procTab[ 1 ].rqIndex >= 0 );
+
+  // a blocked process is switched away from, and not queued
+  procTab[ 0 ].status = STATUS_WAITING;
+  schedule( &testCtx );
+
+  TEST( executing == &procTab[ 1 ] );
+  TEST( procTab[ 1 ].status == STATUS_EXECUTING );
+  TEST( procTab[ 1 ].rqIndex == -1 );
+  TEST( procTab[ 0 ].status == STATUS_WAITING );
+  TEST( procTab[ 0 ].rqIndex == -1 );
+  TEST( cpu->readyNum == 0 );
+
+  // with nothing else ready, a terminated process is replaced by the idle process
+  procTab[ 1 ].status = STATUS_TERMINATED;
+  schedule( &testCtx );
+
+  TEST( executing == &cpu->idle );
+  TEST( procTab[ 1 ].status == STATUS_TERMINATED );
+  TEST( cpu->readyNum == 0 );
+
+  // a process made ready preempts the idle process
+  needResched[ hostCpu ] = 0;
+  make_ready( &procTab[ 0 ], cpu );
+
+  TEST( procTab[ 0 ].status == STATUS_READY );
+  TEST( needResched[ hostCpu ] != 0 );
+
+  schedule( &testCtx );
+
+  TEST( executing == &procTab[ 0 ] );
+  TEST( procTab[ 0 ].status == STATUS_EXECUTING );
+  TEST( needResched[ hostCpu ] == 0 );
+
+  // a normal process which yields is queued again behind another
+  pid_t pid = proc_fork( &testCtx );
+
+  TEST( pid == 1 );
+  TEST( procTab[ 1 ].status == STATUS_READY );
+
+  procTab[ 0 ].yielding = true;
+  schedule( &testCtx );
+
+  TEST( executing == &procTab[ 1 ] );
+  TEST( procTab[ 0 ].status == STATUS_READY );
+  TEST( procTab[ 0 ].rqIndex >= 0 );
+  TEST( procTab[ 0 ].yielding == false );
+}
+
+void test_pipe() {
+  test_boot( 1 );
+
+  pipe_t* p = pipe_alloc(); char x[ BUFFER_SIZE ], y[ BUFFER_SIZE ];
+
+  for( int i = 0; i < BUFFER_SIZE; i++ ) {
+    x[ i ] = 'a' + i;
+  }
+
+  // empty
+  TEST( pipe_read( p, y, 1 ) == 0 );
+  TEST( !p->full );
+
+  // full
+  TEST( pipe_write( p, x, BUFFER_SIZE ) == BUFFER_SIZE );
+  TEST( p->full );
+  TEST( pipe_write( p, x, 1 ) == 0 );
+
+  TEST( pipe_read( p, y, BUFFER_SIZE ) == BUFFER_SIZE );
+  TEST( memcmp( x, y, BUFFER_SIZE ) == 0 );
+  TEST( !p->full );
+  TEST( pipe_read( p, y, 1 ) == 0 );
+
+  // wrap around, in part then in full
+  TEST( pipe_write( p, x, 4 ) == 4 );
+  TEST( pipe_read( p, y, 3 ) == 3 );
+  TEST( pipe_write( p, x, BUFFER_SIZE ) == BUFFER_SIZE - 1 );
+  TEST( p->full );
+
+  TEST( pipe_read( p, y, BUFFER_SIZE ) == BUFFER_SIZE );
+  TEST( y[ 0 ] == x[ 3 ] );
+  TEST( memcmp( y + 1, x, BUFFER_SIZE - 1 ) == 0 );
+  TEST( pipe_read( p, y, 1 ) == 0 );
+}
+
+void test_fd() {
+  test_boot( 1 );
+
+  pipe_t* p = pipe_alloc();
+
+  int r = open_fd( p, RDONLY );
+  int w = open_fd( p, WRONLY );
+
+  TEST( ( r >= 3 ) && ( w >= 3 ) && ( r != w ) );
+  TEST( ( openFileTab[ r ].refCount == 1 ) && ( openFileTab[ w ].refCount == 1 ) );
+  TEST( ( p->readers == 1 ) && ( p->writers == 1 ) );
+
+  // a child shares its parent's open file table entries
+  pid_t pid = proc_fork( &testCtx );
+
+  TEST( ( openFileTab[ r ].refCount == 2 ) && ( openFileTab[ w ].refCount == 2 ) );
+  TEST( ( procTab[ pid ].fdTab[ 0 ] == r ) && ( procTab[ pid ].fdTab[ 1 ] == w ) );
+
+  // closing one process' descriptor keeps the end open
+  TEST( close_fd( r, 0 ) == 0 );
+
+  TEST( openFileTab[ r ].refCount == 1 );
+  TEST( openFileTab[ r ].file == p );
+  TEST( p->readers == 1 );
+  TEST( procTab[ 0 ].fdTab[ 0 ] == -1 );
+
+  // closing the last descriptor of one end closes it, without freeing the pipe
+  test_kill( pid );
+
+  TEST( openFileTab[ r ].refCount == 0 );
+  TEST( openFileTab[ r ].file == NULL );
+  TEST( p->readers == 0 );
+  TEST( openFileTab[ w ].refCount == 1 );
+  TEST( test_frees( p ) == 0 );
+
+  // closing the other end frees it, once
+  TEST( close_fd( w, 0 ) == 0 );
+
+  TEST( openFileTab[ w ].file == NULL );
+  TEST( test_frees( p ) == 1 );
+
+  TEST( close_fd( -1, 0 ) == -1 );
+  TEST( close_fd( MAX_FDS, 0 ) == -1 );
+
+  // a pinned pipe is freed by pipe_wake instead, once unpinned
+  p = pipe_alloc();
+  r = open_fd( p, RDONLY );
+  w = open_fd( p, WRONLY );
+
+  p->pins++;
+  close_fd( r, 0 );
+  close_fd( w, 0 );
+
+  TEST( test_frees( p ) == 0 );
+
+  pipe_wake( p );
+
+  TEST( test_frees( p ) == 1 );
+}
+
+void test_fork() {
+  test_boot( 4 ); // console executing, plus 1...3 ready
+
+  TEST( currentProcesses == 4 );
+
+  // the first slot never used
+  TEST( proc_fork( &testCtx ) == 4 );
+
+  // a terminated process' slot, once its CPU has switched away from it
+  test_kill( 2 );
+
+  TEST( proc_reusable( &procTab[ 2 ] ) );
+  TEST( proc_fork( &testCtx ) == 2 );
+  TEST( procTab[ 2 ].status == STATUS_READY );
+  TEST( currentProcesses == 5 );
+
+  // but not while still current, e.g., if killed while executing on another CPU
+  procTab[ 0 ].status = STATUS_WAITING;
+  while( executing != &procTab[ 3 ] ) {
+    procTab[ executing->pid ].status = STATUS_WAITING;
+    schedule( &testCtx );
+  }
+
+  test_kill( 3 );
+
+  TEST( !proc_reusable( &procTab[ 3 ] ) );
+
+  pid_t pid = proc_fork( &testCtx );
+
+  TEST( pid == 5 );
+  TEST( procTab[ 3 ].status == STATUS_TERMINATED );
+
+  schedule( &testCtx );
+
+  TEST( executing != &procTab[ 3 ] );
+  TEST( proc_reusable( &procTab[ 3 ] ) );
+  TEST( proc_fork( &testCtx ) == 3 );
+
+  // a live process' slot is never reused, so a full table fails
+  test_boot( MAX_PROCS );
+
+  TEST( currentProcesses == MAX_PROCS );
+  TEST( proc_fork( &testCtx ) == -1 );
+  TEST( currentProcesses == MAX_PROCS );
+}
+
+int main( int argc, char* argv[] ) {
+  test_rq();
+  test_sched();
+  test_pipe();
+  test_fd();
+  test_fork();
+
+  printf( "\n# %d of %d checks failed\n", testFails, testChecks );
+
+  return ( testFails > 0 ) ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "bcache.h"
+
+typedef struct {
+  uint32_t    addr; // block address
+  int          len; // block length, 0 iff. the entry is unused
+  uint32_t     seq; // order of buffering
+  uint8_t     data[ BCACHE_BLOCK_LEN ];
+} bcache_entry_t;
+
+bcache_entry_t bcacheTab[ BCACHE_BLOCKS ];
+
+uint32_t       bcacheSeq    = 0; // next order of buffering
+int            bcacheNum    = 0; // number of entries used
+int            bcacheFailed = 0; // write backs failed since the last sync
+
+// the entry for block a, or NULL if none
+bcache_entry_t* bcache_find( uint32_t a ) {
+  for( int i = 0; i < BCACHE_BLOCKS; i++ ) {
+    if( ( bcacheTab[ i ].len != 0 ) && ( bcacheTab[ i ].addr == a ) ) {
+      return &bcacheTab[ i ];
+    }
+  }
+
+  return NULL;
+}
+
+// the entry buffered first, or NULL if none
+bcache_entry_t* bcache_oldest() {
+  bcache_entry_t* e = NULL;
+
+  for( int i = 0; i < BCACHE_BLOCKS; i++ ) {
+    if( ( bcacheTab[ i ].len != 0 ) && ( ( e == NULL ) || ( ( int32_t )( bcacheTab[ i ].seq - e->seq ) < 0 ) ) ) {
+      e = &bcacheTab[ i ];
+    }
+  }
+
+  return e;
+}
+
+bool bcache_write( uint32_t a, const uint8_t* x, int n ) {
+  if( n > BCACHE_BLOCK_LEN ) {
+    return false;
+  }
+
+  bcache_entry_t* e = bcache_find( a );
+
+  if( e == NULL ) {
+    if( bcacheNum == BCACHE_BLOCKS ) { // full, so make room
+      bcache_flush();
+    }
+
+    for( int i = 0; i < BCACHE_BLOCKS; i++ ) {
+      if( bcacheTab[ i ].len == 0 ) {
+        e = &bcacheTab[ i ]; break;
+      }
+    }
+
+    e->addr = a;
+    e->seq  = bcacheSeq++;
+
+    bcacheNum++;
+  }
+
+  e->len = n;
+  memcpy( e->data, x, n );
+
+  return true;
+}
+
+bool bcache_read( uint32_t a, uint8_t* x, int n ) {
+  bcache_entry_t* e = bcache_find( a );
+
+  if( ( e == NULL ) || ( e->len != n ) ) {
+    return false;
+  }
+
+  memcpy( x, e->data, n );
+
+  return true;
+}
+
+bool bcache_flush() {
+  bcache_entry_t* e = bcache_oldest();
+
+  if( e != NULL ) {
+    if( disk_wr( e->addr, e->data, e->len ) < 0 ) {
+      bcacheFailed++;
+    }
+
+    e->len = 0;
+
+    bcacheNum--;
+  }
+
+  return bcacheNum > 0;
+}
+
+int  bcache_sync() {
+  while( bcache_flush() );
+
+  int r = ( bcacheFailed > 0 ) ? DISK_FAILURE : DISK_SUCCESS;
+
+  bcacheFailed = 0;
+
+  return r;
+}
+
+int  bcache_dirty() {
+  return bcacheNum;
+}
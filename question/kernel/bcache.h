@@ -0,0 +1,51 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __BCACHE_H
+#define __BCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include  "disk.h"
+
+/* A write-behind buffer of disk blocks: a block written is copied into the
+ * buffer and written back to the disk later (see work_disk in hilevel.c),
+ * so the writer need not wait for the (slow, UART-based) disk.  A block
+ * read is taken from the buffer if it is there, so reads always observe
+ * preceding writes.  Each block is written back in the order it was first
+ * buffered, and a block written again before being written back is simply
+ * updated.  If the buffer is full, the oldest block is written back at once
+ * to make room.
+ *
+ * Since a block written back may fail, any failure is recorded and reported
+ * by the next sync (i.e., write back of every block).
+ *
+ * The buffer performs no locking: callers must serialise access to it (and
+ * to the disk).
+ */
+
+#define BCACHE_BLOCKS    ( 16 ) // blocks buffered
+#define BCACHE_BLOCK_LEN ( 64 ) // maximum block length buffered
+
+// buffer an n-byte block x to be written to address a, returning false iff. n is too long (so it must be written directly)
+extern bool bcache_write( uint32_t a, const uint8_t* x, int n );
+// read an n-byte block at address a into x iff. it is buffered, returning true iff. so
+extern bool bcache_read( uint32_t a, uint8_t* x, int n );
+
+// write back the oldest buffered block, returning true iff. more remain
+extern bool bcache_flush();
+// write back every buffered block, returning DISK_FAILURE iff. any write back failed since the last sync
+extern int  bcache_sync();
+
+// number of blocks waiting to be written back
+extern int  bcache_dirty();
+
+#endif
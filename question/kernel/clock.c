@@ -0,0 +1,51 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "clock.h"
+
+void clock_init() {
+  vdso.seq     = 0;
+  vdso.counter = &SYSCONF->COUNTER_24MHZ;
+  vdso.freq    = CLOCK_HZ;
+  vdso.low     = *vdso.counter;
+  vdso.high    = 0;
+}
+
+void clock_update() {
+  uint32_t low = *vdso.counter;
+
+  vdso.seq++; mem_barrier(); // mark update in progress
+
+  if( low < vdso.low ) {
+    vdso.high++;             // counter wrapped around since last update
+  }
+  vdso.low = low;
+
+  mem_barrier(); vdso.seq++; // mark update complete
+}
+
+uint64_t clock_read() {
+  uint32_t seq, high, low, now;
+
+  do {
+    seq  = vdso.seq; mem_barrier();
+    high = vdso.high;
+    low  = vdso.low;
+    now  = *vdso.counter;
+    mem_barrier();
+  } while( ( seq & 1 ) || ( seq != vdso.seq ) );
+
+  if( now < low ) {
+    high++;                  // counter wrapped around since last update
+  }
+
+  return ( ( uint64_t )( high ) << 32 ) | now;
+}
+
+uint64_t clock_read_ns() {
+  return ( clock_read() * 125 ) / 3; // = count * 10^9 / 24 * 10^6
+}
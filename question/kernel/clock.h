@@ -0,0 +1,52 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include   "SYS.h"
+
+#include   "smp.h"
+
+/* A monotonic clock, derived from the free-running 32-bit 24MHz counter in
+ * the system registers.  The counter wraps around every ~179 sec., so the
+ * kernel extends it to 64 bits by recording the high word and last value
+ * seen each time clock_update is invoked (at least once per wrap-around).
+ *
+ * These are published in the vDSO page, which is readable by user mode: a
+ * sequence number, odd while an update is in progress, lets a reader detect
+ * a concurrent update and retry, so a user process can read the clock with
+ * no system call.  The layout must match vdso_t in user/libc.h.
+ */
+
+#define CLOCK_HZ 24000000
+
+typedef struct {
+  volatile uint32_t          seq; // sequence number, odd while being updated
+  volatile uint32_t         high; // high word of 64-bit count
+  volatile uint32_t          low; // low  word of 64-bit count, at last update
+  RO       uint32_t*     counter; // free-running counter
+           uint32_t         freq; // counter frequency (Hz)
+} vdso_t;
+
+extern vdso_t vdso;
+
+// initialise clock, publishing the vDSO page
+extern void     clock_init();
+// extend counter, which must happen at least once per wrap-around
+extern void     clock_update();
+
+// read clock as a 64-bit count of 1 / CLOCK_HZ sec. ticks
+extern uint64_t clock_read();
+// read clock in nanoseconds
+extern uint64_t clock_read_ns();
+
+#endif
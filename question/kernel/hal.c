@@ -0,0 +1,37 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "hilevel.h"
+
+extern uint32_t tos_p;
+
+void hal_print( char* x, int n ) {
+  for( int i = 0; i < n; i++ ) {
+    PL011_putc( UART0, x[ i ], true );
+  }
+}
+
+uint32_t hal_counter() {
+  return SYSCONF->COUNTER_24MHZ;
+}
+
+void hal_kick( int id ) {
+  irq_sgi( ( 1 << ( 16 + id ) ) | IPI_RESCHED ); // target list = CPU id only
+}
+
+void hal_wheel( bool f ) {
+  if( f ) {
+    TIMER0->Timer2Ctrl |=  0x00000080; // enable  timer
+  }
+  else {
+    TIMER0->Timer2Ctrl &= ~0x00000080; // disable timer
+  }
+}
+
+uintptr_t hal_stack( int i ) {
+  return ( uintptr_t )( &tos_p ) - ( i - 1 ) * 0x00002000;
+}
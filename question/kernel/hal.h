@@ -0,0 +1,38 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __HAL_H
+#define __HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The process management code (see proc.h) accesses the platform only via
+ * this hardware abstraction layer, plus the spinlock and CPU ID functions in
+ * smp.h, and the trace functions in trace.h.  The kernel implements it using
+ * the UART0, TIMER0, SYSCONF and GIC devices (see hal.c), whereas a native
+ * host build (see host/) implements it in memory, so the scheduler, pipes,
+ * file descriptor tables and fork can be exercised without QEMU.
+ */
+
+// write an n character string to the kernel terminal (i.e., UART0)
+extern void      hal_print( char* x, int n );
+
+// read the free-running 24MHz counter
+extern uint32_t  hal_counter();
+
+// ask CPU id (which is not the executing CPU) to invoke the scheduler
+extern void      hal_kick( int id );
+
+// enable (iff. f = true) or disable the timer wheel tick
+extern void      hal_wheel( bool f );
+
+// address of the top of stack of the process in PCB i, where i > 0
+extern uintptr_t hal_stack( int i );
+
+#endif
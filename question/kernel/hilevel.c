@@ -15,7 +15,10 @@
  *   index into it to keep track of the currently executing process.
  * - facilitating a processor context switch between executing and other
  *   saved processes, selected by a scheduling algorithm.
- * - the handling of reset, IRQ and SVC interrupt signals
+ * - the handling of reset, IRQ and SVC interrupt signals, where IRQ handlers
+ *   are registered per interrupt source with a priority, may nest, and can
+ *   defer work to bottom halves executed with IRQ interrupts enabled (see
+ *   irq.h)
  * 
  * The kernel is also responsible for the storage and management of a file
  * system, monitored using a central open file table. Each process is provided
@@ -24,177 +27,266 @@
  * The creation of unnamed pipes is also handled by the kernel, facilitating
  * IPC. Pipes manifest as a buffer, stored as a file and referenced using
  * file descriptors.
+ *
+ * User-space synchronisation is supported by a futex (fast user-space mutex)
+ * system call: processes block waiting on a shared memory address, and are
+ * queued in a hashed table of wait queues until another process wakes them.
+ * The same wait queues hold processes blocked reading from an empty pipe.
+ *
+ * Processes can sleep, or bound how long they wait, using a timer wheel. It
+ * is advanced every millisecond by the second channel of TIMER0, which only
+ * runs while some timer is armed.
+ *
+ * Processes are scheduled in two classes: real-time processes (SCHED_FIFO
+ * or SCHED_RR, selected via sched_setscheduler) take strict priority, and
+ * normal processes share the CPU in proportion to a weight derived from
+ * their niceness (see schedule in proc.c).  Processes can also be placed in
+ * a group, whose processes together are limited to a quota of CPU time per
+ * period: once it is used up, they are not scheduled until the next period.
+ * The scheduler is invoked on a timer tick, when a process blocks, yields
+ * or terminates, and on return from any IRQ or SVC handler which made ready
+ * a process that should preempt the executing one (e.g., a pipe reader
+ * woken by a write), so the woken process need not wait for the next tick.
+ *
+ * On a multi-core platform each CPU executes its own process, selected from
+ * its own run queue of ready processes, and runs an idle process if none is
+ * ready.  The primary CPU boots the secondary CPUs, and then forwards each
+ * timer tick to them via an IPI (an SGI, in GIC terms).  Load is balanced
+ * by an idle CPU stealing work from the busiest run queue, and periodically
+ * migrating processes from the busiest to the least busy CPU: in the latter
+ * case only processes whose cache state is assumed to be cold are moved.
+ *
+ * Context switches, system calls, interrupts and pipe operations are recorded
+ * in a trace buffer, which is printed lazily (see trace.h).  The time each
+ * process spends in user mode, system calls and interrupt handlers is also
+ * accounted for, as is the latency of each system call: the latter is kept
+ * as a histogram per system call, with buckets of exponentially increasing
+ * width, so the cost of recording it is constant.  A sampling profiler can
+ * also be run on demand (see profile.h).
+ *
+ * The handlers below are built on the process management code in proc.c,
+ * which only accesses the platform via hal.h: it can therefore be built,
+ * tested and benchmarked natively on a host (see Makefile.host).
+ *
+ * Shared state is protected by spinlocks, acquired in the order
+ *
+ * - procLock: the process table (allocation of PCBs), futex wait queues and
+ *   the timer wheel,
+ * - a per-CPU run queue lock: the run queue, and the status of processes in
+ *   it or executing on the CPU (when two are needed, the lower ID first),
+ * - groupLock: the CPU time used by each process group, and the processes
+ *   parked by a group which has used up its quota,
+ * - fileLock: the open file table and the pipes it references (which is
+ *   never held with groupLock).
+ *
+ * The disk is accessed (via UART2) under diskLock, which is never held with
+ * the locks above.  Blocks written are buffered (see bcache.h), then written
+ * back by a work item, i.e., after the system call and with IRQ interrupts
+ * enabled.  Each lock other than diskLock is held only with IRQ interrupts
+ * disabled, since an interrupt handler on the same CPU may acquire it.
  */
 
 // Initialize global variables and declare arrays and pointers
-int currentProcesses = 0;
-uint32_t time = 0;
+uint32_t ticks = 0;
+
+uint32_t svcHist[MAX_CPUS][MAX_SVCS][SVC_HIST_BUCKETS]; // system call latency histograms, per CPU
 
-pcb_t procTab[MAX_PROCS];
-fd_t openFileTab[MAX_FDS];
+spinlock_t diskLock = 0;
 
-pcb_t *executing = NULL;
+int diskBlockLen = 0; // disk block length, queried on first use
 
 extern void main_console();
 extern uint32_t tos_console;
-extern uint32_t tos_p;
 
-// Print an n character string to the terminal
-void print(char *x, int n)
+// Charge the time since the last accounting point on this CPU to x, starting a new one; return the time charged
+uint32_t acct_charge(uint64_t *x)
 {
-  for (int i = 0; i < n; i++)
-  {
-    PL011_putc(UART0, x[i], true);
-  }
+  cpu_t *cpu = &cpus[cpu_id()];
+  uint32_t now = hal_counter();
+  uint32_t t = now - cpu->stamp;
+
+  *x += t;
+  cpu->stamp = now;
+
+  return t;
 }
 
-//  Print a PID (0-99) to the terminal
-void printPID(int pid)
+// Record a latency of t cycles for system call id in the histogram of this CPU, i.e., in bucket floor(log2(t))
+void svc_record(uint32_t id, uint32_t t)
 {
-  int units = pid % 10;
-  if (pid >= 10)
-  {
-    int tens = (pid - units) / 10;
-    PL011_putc(UART0, '0' + tens, true);
-  }
-  PL011_putc(UART0, '0' + units, true);
+  int i = 31 - __builtin_clz(t | 1);
+
+  if (i >= SVC_HIST_BUCKETS)
+    i = SVC_HIST_BUCKETS - 1;
+
+  svcHist[cpu_id()][id][i]++;
 }
 
-// Context switch from the previous to the next process, print [prev->next]
-void dispatch(ctx_t *ctx, pcb_t *prev, pcb_t *next)
+/* Interrupt handlers (see irq.h), registered on reset: none switches
+ * context itself, but rather sets needResched so the scheduler is invoked
+ * before returning to USR mode, so each can also be invoked nested.
+ */
+
+// Timer interrupt handler: the second channel of TIMER0 is the timer wheel tick
+void irq_timer(ctx_t *ctx, uint32_t id)
 {
-  PL011_putc(UART0, '[', true);
+  TIMER0->Timer2IntClr = 0x01;
 
-  if (NULL != prev)
-  {
-    memcpy(&prev->ctx, ctx, sizeof(ctx_t)); // preserve execution context of P_{prev}
-    printPID(prev->pid);
-  }
-  else
-  {
-    PL011_putc(UART0, '?', true);
-  }
+  spin_lock(&procLock);
+  timer_tick();
+  group_enforce();
+  wheel_update();
+  spin_unlock(&procLock);
 
-  PL011_putc(UART0, '-', true);
-  PL011_putc(UART0, '>', true);
+  return;
+}
 
-  if (NULL != next)
-  {
-    memcpy(ctx, &next->ctx, sizeof(ctx_t)); // restore execution context of P_{next}
-    printPID(next->pid);
-  }
-  else
-  {
-    PL011_putc(UART0, '?', true);
-  }
+/* The scheduler tick, i.e., the first channel of TIMER2, is signalled as an
+ * FIQ, so it is taken even during another handler and costs only a partial
+ * save of the execution context.  The FIQ handler just counts the tick, and
+ * hands it on (as IPI_TICK, i.e., an IRQ taken once IRQ interrupts are next
+ * enabled) iff. it is worth invoking the scheduler, i.e., if another process
+ * is ready, or if the tick must be handled in full anyway: so a CPU with a
+ * single process to execute is rarely interrupted at length.  Since it can
+ * interrupt any handler, it must only access state no handler updates, and
+ * can not acquire any lock.  If the GIC does not support groups, the tick is
+ * signalled as an IRQ instead, whose handler does the rest of the tick in
+ * place rather than via a second IRQ.
+ */
+
+// Count a scheduler tick, then return true iff. there is more to do
+bool tick_count()
+{
+  TIMER2->Timer1IntClr = 0x01;
+  ticks++;
+
+  return MAX_CPUS > 1 || cpus[cpu_id()].readyNum > 0 || ticks % TICK_SLOW_PERIOD == 0; // (the run queue is read without its lock, so may be stale)
+}
 
-  PL011_putc(UART0, ']', true);
+// Tick IPI handler: the rest of a scheduler tick
+void irq_tick(ctx_t *ctx, uint32_t id)
+{
+  clock_update(); // extend clock well within the counter wrap-around period
+  irq_bh_raise(BH_TRACE);
 
-  executing = next; // update executing process to P_{next}
+#if MAX_CPUS > 1
+  if (ticks % BALANCE_PERIOD == 0)
+    rq_balance();
+  irq_sgi(0x01000000 | IPI_RESCHED); // forward tick to all CPUs except this one
+#endif
+  needResched[cpu_id()] = 1;
 
   return;
 }
 
-/* Scheduling algorithm
-*  considers all eligible processes and selects the one to be run 
-*  next based on a series of factors:
-*
-*  - Is it the currently executing process?
-*  - The base priority of the process
-*  - The time since its last execution
-*/
-void schedule(ctx_t *ctx)
+// Scheduler tick interrupt handler, iff. the GIC signals it as an IRQ (see irq.h)
+void irq_tick_irq(ctx_t *ctx, uint32_t id)
 {
-  int prevIndex = executing->pid;
-  int nextIndex = executing->pid;                // default next = currently executing
-  int highestPriority = executing->niceness - 1; // favour against re-selecting currently executing process
+  if (tick_count())
+    irq_tick(ctx, id);
 
-  for (int i = 0; i < MAX_PROCS; i++)
+  return;
+}
+
+// Profiler interrupt handler: the first channel of TIMER1 on CPU 0, forwarded to any other CPUs as IPI_PROFILE
+void irq_profile(ctx_t *ctx, uint32_t id)
+{
+  if (id == GIC_SOURCE_TIMER1)
   {
-    if (procTab[i].status == STATUS_READY)
-    {
-      double ipriority = (time - procTab[i].lastExec) - procTab[i].niceness; // priority + time since last exec
-      if (ipriority >= highestPriority)
-      {
-        highestPriority = ipriority;
-        nextIndex = i;
-      }
-    }
+    TIMER1->Timer1IntClr = 0x01;
+#if MAX_CPUS > 1
+    irq_sgi(0x01000000 | IPI_PROFILE); // forward tick to all CPUs except this one
+#endif
   }
 
-  dispatch(ctx, executing, &procTab[nextIndex]); // context switch previous -> next
+  profile_sample(ctx->pc, executing->pid);
 
-  procTab[prevIndex].lastExec = time;
-  if (procTab[prevIndex].status == STATUS_EXECUTING)
-    procTab[prevIndex].status = STATUS_READY;   // update execution status of previous process
-  procTab[nextIndex].status = STATUS_EXECUTING; // update execution status of next process
+  return;
+}
+
+// Reschedule IPI handler
+void irq_resched(ctx_t *ctx, uint32_t id)
+{
+  needResched[cpu_id()] = 1;
+
+  return;
+}
+
+// Bottom half IPI handler: nothing to do, since bottom halves are executed on return from any handler
+void irq_softirq(ctx_t *ctx, uint32_t id)
+{
+  return;
+}
 
-  time++;
+// Trace bottom half: drain some of the trace, without waiting for the UART
+void bh_trace()
+{
+  trace_drain(TRACE_BUDGET, false);
 
   return;
 }
 
+// Disk work item: write back the buffered blocks, one per acquisition of diskLock so other CPUs can interleave
+void work_disk(work_t *x)
+{
+  bool more = true;
+
+  while (more)
+  {
+    spin_lock(&diskLock); // never acquired by a handler, so can be held with IRQ interrupts enabled
+    more = bcache_flush();
+    spin_unlock(&diskLock);
+  }
+
+  return;
+}
+
+work_t diskWork = {.fn = &work_disk};
+
 // Reset interrupt handler
 void hilevel_handler_rst(ctx_t *ctx)
 {
   PL011_putc(UART0, 'R', true);
 
-  TIMER0->Timer1Load = 0x00100000;  // select period = 2^20 ticks ~= 1 sec
-  TIMER0->Timer1Ctrl = 0x00000002;  // select 32-bit   timer
-  TIMER0->Timer1Ctrl |= 0x00000040; // select periodic timer
-  TIMER0->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
-  TIMER0->Timer1Ctrl |= 0x00000080; // enable          timer
-
-  GICC0->PMR = 0x000000F0;         // unmask all            interrupts
-  GICD0->ISENABLER1 |= 0x00000010; // enable timer          interrupt
-  GICC0->CTLR = 0x00000001;        // enable GIC interface
-  GICD0->CTLR = 0x00000001;        // enable GIC distributor
+  TIMER2->Timer1Load = 0x00100000;  // select period = 2^20 ticks ~= 1 sec
+  TIMER2->Timer1Ctrl = 0x00000002;  // select 32-bit   timer
+  TIMER2->Timer1Ctrl |= 0x00000040; // select periodic timer
+  TIMER2->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
+  TIMER2->Timer1Ctrl |= 0x00000080; // enable          timer
+
+  TIMER0->Timer2Load = 1000000 / TIMER_HZ; // select period = 1 / TIMER_HZ sec
+  TIMER0->Timer2Ctrl = 0x00000002;  // select 32-bit   timer
+  TIMER0->Timer2Ctrl |= 0x00000040; // select periodic timer
+  TIMER0->Timer2Ctrl |= 0x00000020; // enable          timer interrupt
+                                    // (enabled by wheel_update iff. a timer is armed)
+
+  irq_register(GIC_SOURCE_TIMER2, IRQ_PRI_FIQ, IRQ_FIQ, &irq_tick_irq); // scheduler tick
+  irq_register(GIC_SOURCE_TIMER0, IRQ_PRI_TIMER, 0, &irq_timer);   // timer wheel tick
+  irq_register(IPI_TICK, IRQ_PRI_TIMER, 0, &irq_tick);
+  irq_register(GIC_SOURCE_TIMER1, IRQ_PRI_TIMER, 0, &irq_profile); // profiler tick
+  irq_register(IPI_PROFILE, IRQ_PRI_TIMER, 0, &irq_profile);
+  irq_register(IPI_RESCHED, IRQ_PRI_IPI, 0, &irq_resched);
+  irq_register(IPI_SOFTIRQ, IRQ_PRI_IPI, 0, &irq_softirq);
+  irq_bh_register(BH_TRACE, &bh_trace);
+  irq_bh_register(BH_WORK, &work_run);
+
+  irq_init_cpu();                  // enable GIC interface
+  GICD0->CTLR = 0x00000003;        // enable GIC distributor, for both groups
 
   int_enable_irq();
+  int_enable_fiq();
 
-  /* Invalidate all entries in the process table, so it's clear they are not
-   * representing valid (i.e., active) processes.
-   */
-  for (int i = 0; i < MAX_PROCS; i++)
-  {
-    procTab[i].status = STATUS_INVALID;
-  }
+  timer_init();
+  clock_init();
+  trace_init();
+  pmu_init();
 
-  //initialise open file table
-  for (int i = 0; i < MAX_FDS; i++)
-  {
-    if (i < 3)
-    {
-      openFileTab[i].refCount = 1;
-      if (i == 0)
-        openFileTab[i].flag = RDONLY;
-      else
-        openFileTab[i].flag = WRONLY;
-    }
-    else
-      openFileTab[i].refCount = 0;
-  }
+  proc_init((uintptr_t)(&lolevel_idle));
 
-  /* Automatically execute the user programs P1 and P2 by setting the fields
-   * in two associated PCBs.  Note in each case that
-   *    
-   * - the CPSR value of 0x50 means the processor is switched into USR mode, 
-   *   with IRQ interrupts enabled, and
-   * - the PC and SP values match the entry point and top of stack. 
+  /* Automatically execute the console by setting the fields in the 0-th
+   * PCB (see proc_spawn).
    */
-  memset(&procTab[0], 0, sizeof(pcb_t)); // initialise 0-th PCB = console
-  procTab[0].pid = 0;
-  procTab[0].status = STATUS_READY;
-  procTab[0].tos = (uint32_t)(&tos_console);
-  procTab[0].ctx.cpsr = 0x50;
-  procTab[0].ctx.pc = (uint32_t)(&main_console);
-  procTab[0].ctx.sp = procTab[0].tos;
-  procTab[0].lastExec = time;
-  procTab[0].niceness = 0;
-  for (int i = 0; i < MAX_FDS; i++)
-    procTab[0].fdTab[i] = -1;
-
-  currentProcesses++;
+  proc_spawn(0, (uintptr_t)(&main_console), (uintptr_t)(&tos_console));
 
   /* Once the PCB has been initialised, we select the 0-th PCB (console) to be 
    * executed: there is no need to preserve the execution context, since it 
@@ -202,421 +294,1058 @@ void hilevel_handler_rst(ctx_t *ctx)
    */
 
   dispatch(ctx, NULL, &procTab[0]);
+  procTab[0].status = STATUS_EXECUTING;
+
+  /* Release the secondary CPUs (if any) from the boot loader, which waits
+   * for an interrupt and then jumps to the address in the SYS flags register.
+   */
+#if MAX_CPUS > 1
+  SYSCONF->FLAGSCLR = 0xFFFFFFFF;
+  SYSCONF->FLAGSSET = (uint32_t)(&lolevel_handler_sec);
+  irq_sgi(0x01000000 | IPI_RESCHED); // target list = all CPUs except this one
+#endif
 
   return;
 }
 
-// Interrupt request handler
-void hilevel_handler_irq(ctx_t *ctx)
+// Secondary CPU reset handler
+void hilevel_handler_sec(ctx_t *ctx)
+{
+  irq_init_cpu(); // enable GIC interface
+
+  // Acknowledge the SGI which released this CPU from the boot loader.
+  uint32_t iar = GICC0->IAR;
+  if ((iar & 0x3FF) != 0x3FF)
+    GICC0->EOIR = iar;
+
+  cpu_t *cpu = &cpus[cpu_id()];
+
+  cpu->stamp = hal_counter();
+  pmu_init();
+
+  dispatch(ctx, NULL, &cpu->idle); // start idle, then pick up (or steal) any ready process
+  cpu->online = true;
+  schedule(ctx);
+
+  return;
+}
+
+/* Fast interrupt request handler: the scheduler tick.  Since AckCtl is set,
+ * IAR may instead acknowledge an IRQ (e.g., if the tick is no longer pending
+ * once read): its handler may acquire a spinlock this CPU holds, so rather
+ * than execute it, the FIQ handler hands it back to the GIC.  A level-
+ * sensitive source remains pending after the EOI, but an SGI does not so is
+ * sent again (its handler ignores the source CPU).
+ *
+ * Neither QEMU board models a GIC with groups, so this path is untested.
+ */
+
+void hilevel_handler_fiq()
 {
-  // Read  the interrupt identifier so we know the source.
-  uint32_t id = GICC0->IAR;
+  uint32_t iar = GICC0->IAR;
+  uint32_t id = iar & 0x3FF;
 
-  // Handle the interrupt, then clear (or reset) the source.
-  if (id == GIC_SOURCE_TIMER0)
+  if (id == GIC_SOURCE_TIMER2)
   {
-    TIMER0->Timer1IntClr = 0x01;
-    schedule(ctx);
+    if (tick_count())
+      irq_sgi(0x02000000 | IPI_TICK); // target list = this CPU only
+    GICC0->EOIR = iar;
+  }
+  else if (id < GIC_SOURCES) // an IRQ, so hand it back; else spurious
+  {
+    GICC0->EOIR = iar;
+    if (id < GIC_SOURCE_SGI0 + 16)
+      irq_sgi(0x02000000 | id); // target list = this CPU only
   }
 
-  // Write the interrupt identifier to signal we're done.
-  GICC0->EOIR = id;
+  return;
+}
+
+// Interrupt request handler
+void hilevel_handler_irq(ctx_t *ctx)
+{
+  pcb_t *self = executing; // interrupted process, charged for the handler
+
+  acct_charge(&self->stats.userCycles);
+
+  irq_handle(ctx);
+  irq_bh_run();
+
+  acct_charge(&self->stats.irqCycles);
+
+  return;
+}
+
+// Nested interrupt request handler, i.e., for an IRQ which interrupted a handler or bottom half
+void hilevel_handler_nest()
+{
+  pcb_t *self = executing; // interrupted process, charged for the handler (as for the one it interrupted)
+
+  irq_handle(NULL);
+
+  acct_charge(&self->stats.irqCycles);
+
+  return;
+}
+
+/* Reschedule handler: invoked by the low-level IRQ and SVC handlers, before
+ * returning to USR mode, iff. needResched is set for this CPU, i.e., the
+ * handler made ready a process which should preempt the executing one.
+ */
+void hilevel_handler_resched(ctx_t *ctx)
+{
+  pcb_t *self = executing; // preempted process, charged for the switch
+
+  schedule(ctx);
+
+  acct_charge(&self->stats.kernelCycles);
 
   return;
 }
 
-// Allocate memory and fd to file
-int open_fd(pipe_t *p, int flag)
+/* Write n bytes from x to, or read n bytes into x from, the file at fd,
+ * i.e., the console (fds 0...2) or a pipe, returning the number of bytes
+ * transferred, or -1 for failure.  A transfer which could make a process
+ * blocked on the pipe ready (i.e., a write with blocked readers, or either
+ * with blocked pollers) sets *wake to it rather than waking them, so a
+ * system call transferring many buffers (e.g., writev) wakes them once,
+ * after the last, via pipe_wake; the pipe is pinned until then.
+ */
+
+int file_write(int fd, char *x, int n, pipe_t **wake)
 {
-  int fd = -1;
+  switch (fd)
+  {
+  case 0: //stdin
+    return 0;
 
-  for (int i = 3; i < MAX_FDS; i++)
+  case 1: //stdout
+  case 2: //stderr, which shares the console with stdout
+    for (int i = 0; i < n; i++)
+      PL011_putc(UART0, *x++, true);
+    return n;
+
+  default: // write from x to pipe at fd
   {
-    if (openFileTab[i].refCount == 0) // file not open
+    if (fd < 0 || fd >= MAX_FDS)
     {
-      fd = i;
-
-      // add pipe to open file table
-      openFileTab[fd].file = p;
-      openFileTab[fd].flag = flag;
-      openFileTab[fd].refCount++;
-
-      // add pipe to process' fd table
-      for (int j = 0; j < MAX_FDS; j++)
-      {
-        if (executing->fdTab[j] < 0) // table entry unused
-        { 
-          executing->fdTab[j] = fd;
-          break;
-        }
-      }
+      print("\nERR: cannot address fd", 23);
+      return -1;
+    }
 
-      break;
+    spin_lock(&fileLock);
+    pipe_t *pipe = openFileTab[fd].file;
+    if (pipe == NULL) // (checked under the lock, since another CPU may close fd)
+    {
+      spin_unlock(&fileLock);
+      print("\nERR: cannot address fd", 23);
+      return -1;
     }
-  }
+    int i = pipe_write(pipe, x, n);
+    if (i > 0 && (pipe->waiting > 0 || !waitq_empty(&pipe->pollq)) && *wake == NULL)
+    {
+      *wake = pipe;
+      pipe->pins++; // until pipe_wake, since fd may be closed once fileLock is released
+    }
+    spin_unlock(&fileLock);
+
+    trace(TRACE_PIPE_WR, executing->pid, fd, i);
 
-  return fd;
+    return i;
+  }
+  }
 }
 
-// Make file descriptor and, if no longer needed, file's allocated memory available
-int close_fd(int fd, pid_t pid)
+int file_read(int fd, char *x, int n, pipe_t **wake)
 {
-  int r = -1; // fd index out of bounds
+  switch (fd)
+  {
+  case 0: //stdin
+    //scan from console
+    print("\nread stdin", 11);
+    return 0; // success
+
+  case 1: //stdout
+    print("\nread stdout", 12);
+    return 0; // success
+
+  case 2: //stderr
+    print("\nread error", 11);
+    return -1; // error
 
-  if (fd >= 0 && fd < MAX_FDS)
+  default: //read from pipe at fd into x
   {
-    // wipe the process' corresponding file descriptor
-    for (int i = 0; i < MAX_FDS; i++)
+    if (fd < 0 || fd >= MAX_FDS)
     {
-      if (procTab[pid].fdTab[i] == fd)
-        procTab[pid].fdTab[i] = -1;
+      print("\nERR: cannot address fd", 23);
+      return -1;
     }
 
-    // update file reference count
-    openFileTab[fd].refCount--;
+    spin_lock(&fileLock);
+    pipe_t *pipe = openFileTab[fd].file;
+    if (pipe == NULL) // (checked under the lock, since another CPU may close fd)
+    {
+      spin_unlock(&fileLock);
+      print("\nERR: cannot address fd", 23);
+      return -1;
+    }
+    int i = pipe_read(pipe, x, n);
+    if (i > 0 && !waitq_empty(&pipe->pollq) && *wake == NULL)
+    {
+      *wake = pipe;
+      pipe->pins++; // until pipe_wake, since fd may be closed once fileLock is released
+    }
+    spin_unlock(&fileLock);
 
-    // free file data if no descriptors for it remain
-    if (openFileTab[fd].refCount <= 0)
-      free(openFileTab[fd].file);
+    trace(TRACE_PIPE_RD, executing->pid, fd, i);
+
+    return i;
+  }
+  }
+}
+
+/* System call handlers, one per system call ID, each of which
+ *
+ * - reads  the arguments from preserved usr mode registers,
+ * - performs whatever is appropriate for this system call, then
+ * - writes any return value back to preserved usr mode registers.
+ *
+ * Each system call acquires whichever of the spinlocks guards
+ * the state it accesses.
+ */
+
+// 0x00 => yield()
+void svc_yield(ctx_t *ctx)
+{
+  executing->yielding = true;
+  schedule(ctx);
+
+  return;
+}
+
+// 0x01 => write( fd, x, n )
+void svc_write(ctx_t *ctx)
+{
+  int fd = (int)(ctx->gpr[0]);
+  char *x = (char *)(ctx->gpr[1]);
+  int n = (int)(ctx->gpr[2]);
+
+  pipe_t *wake = NULL;
+  ctx->gpr[0] = file_write(fd, x, n, &wake);
+
+  if (wake != NULL) // complete blocked reads
+    pipe_wake(wake);
+
+  return;
+}
+
+// 0x02 => read( fd, x, n )
+void svc_read(ctx_t *ctx)
+{
+  int fd = (int)(ctx->gpr[0]);
+  char *x = (char *)(ctx->gpr[1]);
+  int n = (int)(ctx->gpr[2]);
+
+  pipe_t *wake = NULL;
+  ctx->gpr[0] = file_read(fd, x, n, &wake);
+
+  if (wake != NULL) // complete blocked polls
+    pipe_wake(wake);
+
+  return;
+}
+
+// 0x03 => fork()
+void svc_fork(ctx_t *ctx)
+{
+  spin_lock(&procLock);
+
+  ctx->gpr[0] = proc_fork(ctx); // parent return value = child PID, or -1 if table full
+
+  spin_unlock(&procLock);
+
+  return;
+}
+
+// 0x04 => exit( x )
+void svc_exit(ctx_t *ctx)
+{
+  int x = (int)ctx->gpr[0];
 
-    r = 0; // success
+  trace(TRACE_EXIT, executing->pid, x, 0);
 
+  // close fds
+  for (int i = 0; i < MAX_FDS; i++)
+  {
+    int    fd = executing->fdTab[i];
+    pid_t pid = executing->pid;
+    if (fd >= 0)
+      close_fd(fd, pid);
   }
 
-  return r;
+  spin_lock(&procLock);
+  executing->status = STATUS_TERMINATED;
+  currentProcesses--;
+  schedule(ctx);
+  spin_unlock(&procLock);
+
+  return;
 }
 
-// Supervisor call handler
-void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
+// 0x05 => exec( x )
+void svc_exec(ctx_t *ctx)
 {
-  /* Based on the identifier (i.e., the immediate operand) extracted from the
-   * svc instruction, 
-   *
-   * - read  the arguments from preserved usr mode registers,
-   * - perform whatever is appropriate for this system call, then
-   * - write any return value back to preserved usr mode registers.
-   */
+  trace(TRACE_EXEC, executing->pid, ctx->gpr[0], 0);
+
+  ctx->pc = (uint32_t)(ctx->gpr[0]); // replace process image
+  ctx->sp = executing->tos;          // reset stack pointer
+
+  return;
+}
+
+// 0x06 => kill( pid, x )
+void svc_kill(ctx_t *ctx)
+{
+  pid_t pid = (pid_t)ctx->gpr[0];
+  int x = (int)ctx->gpr[1];
+
+  trace(TRACE_KILL, executing->pid, pid, x);
 
-  switch (id)
+  if (pid < 0 || pid >= MAX_PROCS)
   {
-  case 0x00: // 0x00 => yield()
+    ctx->gpr[0] = -1;
+    return;
+  }
+
+  spin_lock(&procLock);
+
+  // remove from whichever queue the process is in, before closing any pipe it waits on
+  pcb_t *p = &procTab[pid];
+  cpu_t *cpu = rq_lock(p);
+  status_t status = p->status;
+
+  if (status == STATUS_INVALID || status == STATUS_TERMINATED) // no such process, or already killed
   {
-    schedule(ctx);
+    spin_unlock(&cpu->lock);
+    spin_unlock(&procLock);
 
-    break;
+    ctx->gpr[0] = -1;
+    return;
   }
 
-  case 0x01: // 0x01 => write( fd, x, n )
+  // the status changes under the run queue lock, so a victim about to block sees it (see block)
+  if (status == STATUS_WAITING)
+    wait_cancel(p);
+  else if (status == STATUS_READY)
   {
-    int fd = (int)(ctx->gpr[0]);
-    char *x = (char *)(ctx->gpr[1]);
-    int n = (int)(ctx->gpr[2]);
+    rq_remove(cpu, p);
+    group_remove(p); // iff. parked by its group
+  }
 
-    if (fd < 0)
-    {
-      print("\nERR: cannot address negative fd", 32);
-      ctx->gpr[0] = -1;
-    }
+  p->status = STATUS_TERMINATED;
+  spin_unlock(&cpu->lock);
+  spin_unlock(&procLock);
+
+  // close fds, without procLock since closing a pipe may wake processes polling it
+  for (int i = 0; i < MAX_FDS; i++)
+  {
+    int    fd = procTab[pid].fdTab[i];
+    if (fd >= 0)
+      close_fd(fd, pid);
+  }
+
+  spin_lock(&procLock);
+
+  currentProcesses--;
+
+  ctx->gpr[0] = 0;
+
+  if (status == STATUS_EXECUTING) // stop it, wherever it is executing
+  {
+    if (p == executing)
+      schedule(ctx);
     else
-    {
-      switch (fd)
-      {
-      case 0: //stdin
-      {
-        ctx->gpr[0] = 0;
-        break;
-      }
-
-      case 1: //stdout
-      {
-        for (int i = 0; i < n; i++)
-          PL011_putc(UART0, *x++, true);
-        ctx->gpr[0] = n;
-        break;
-      }
-
-      case 2: //stderr
-      {
-        print("\nwrite error", 12);
-        ctx->gpr[0] = -1;
-        break;
-      }
-
-      default: // write from x to pipe at fd
-      {
-        // the pipe's buffer is implemented as a circular queue
-        pipe_t *pipe = openFileTab[fd].file;
-        int i = 0;
-        for (; i < n; i++)
-        {
-          if (pipe->full)
-            break;
-          pipe->rear = (pipe->rear + 1) % pipe->size;
-          pipe->buffer[pipe->rear] = *x;
-          x++;
-          if (pipe->front == (pipe->rear + 1) % pipe->size) // check if queue full
-          {
-            pipe->full = true;
-          }
-        }
-        ctx->gpr[0] = i;
-        break;
-      }
-      }
-    }
+      cpu_kick(cpu->id);
+  }
 
-    break;
+  spin_unlock(&procLock);
+
+  return;
+}
+
+// 0x07 => nice( pid, x )
+void svc_nice(ctx_t *ctx)
+{
+  pid_t pid = (pid_t)ctx->gpr[0];
+  int x = (int)ctx->gpr[1];
+
+  if (x < -19)
+    x = -19;
+  else if (x > 20)
+    x = 20;
+
+  procTab[pid].niceness = x;
+
+  trace(TRACE_NICE, executing->pid, pid, x);
+
+  ctx->gpr[0] = x;
+
+  return;
+}
+
+// 0x08 => pipe( pipedes[2] )
+void svc_pipe(ctx_t *ctx)
+{
+  int *pipedes = (int *)ctx->gpr[0];
+
+  pipe_t *p = pipe_alloc(); // initialise pipe struct
+
+  int fd_read = open_fd(p, RDONLY); // open read end
+
+  int fd_write = open_fd(p, WRONLY); // open write end
+
+  if (fd_read == -1 || fd_write == -1) // pipe creation failed
+  {
+    print("\npipe failed", 12);
+    pid_t pid = executing->pid;
+    if (fd_read >= 0)
+      close_fd(fd_read, pid);
+    if (fd_write >= 0)
+      close_fd(fd_write, pid);
+
+    ctx->gpr[0] = -1; // failure
   }
 
-  case 0x02: // 0x02 => read( fd, x, n )
+  else
   {
-    int fd = (int)(ctx->gpr[0]);
-    char *x = (char *)(ctx->gpr[1]);
-    int n = (int)(ctx->gpr[2]);
+    int pipefds[2];
+    pipefds[0] = fd_read;
+    pipefds[1] = fd_write;
+    memcpy(pipedes, pipefds, 2 * sizeof(int)); // return fd indices
+
+    ctx->gpr[0] = 0; // success
+  }
+
+  return;
+}
+
+// 0x09 => close( fd )
+void svc_close(ctx_t *ctx)
+{
+  int fd = (int)ctx->gpr[0];
+
+  pid_t pid = executing->pid;
+
+  ctx->gpr[0] = close_fd(fd, pid);
+
+  return;
+}
+
+// 0x0B => futex( addr, op, x, ms )
+void svc_futex(ctx_t *ctx)
+{
+  uint32_t *addr = (uint32_t *)ctx->gpr[0];
+  int op = (int)ctx->gpr[1];
+  uint32_t x = (uint32_t)ctx->gpr[2];
+  uint32_t ms = (uint32_t)ctx->gpr[3];
+
+  spin_lock(&procLock);
 
-    if (fd < 0)
+  switch (op)
+  {
+  case FUTEX_WAIT:       // block iff. *addr still holds x, otherwise let caller retry
+  case FUTEX_WAIT_TIMED: // ditto, but for at most ms
+  {
+    if (*addr != x)
     {
-      print("\nERR: cannot address negative fd", 32);
       ctx->gpr[0] = -1;
     }
     else
     {
-      switch (fd)
-      {
-      case 0: //stdin
-      {
-        //scan from console
-        print("\nread stdin", 11);
-        ctx->gpr[0] = 0; // success
-        break;
-      }
-
-      case 1: //stdout
-      {
-        print("\nread stdout", 12);
-        ctx->gpr[0] = 0; // success
-        break;
-      }
-
-      case 2: //stderr
-      {
-        print("\nread error", 11);
-        ctx->gpr[0] = -1; // error
-        break;
-      }
-
-      default: //read from pipe at fd into x
-      {
-        // the pipe's buffer is implemented as a circular queue
-        pipe_t *pipe = openFileTab[fd].file;
-        int i = 0;
-        for (; i < n; i++)
-        {
-          int front = pipe->front;
-
-          if ((front == (pipe->rear + 1) % pipe->size) && !pipe->full) // check queue empty
-            break;
-          *(x + i) = pipe->buffer[front];
-          pipe->front = (front + 1) % pipe->size;
-          if (pipe->full)
-            pipe->full = false;
-        }
-        ctx->gpr[0] = i;
-        break;
-      }
-      }
+      ctx->gpr[0] = -2; // return value unless woken, i.e., timed out
+
+      futex_enqueue(executing, (uintptr_t)addr);
+      block(ctx, (op == FUTEX_WAIT_TIMED) ? ms : TIMEOUT_INFINITE);
     }
+    break;
+  }
 
+  case FUTEX_WAKE: // wake up to x waiters, return number woken
+  {
+    ctx->gpr[0] = futex_wake((uintptr_t)addr, (int)x);
     break;
   }
 
-  case 0x03: // 0x03 => fork()
+  default:
   {
-    PL011_putc(UART0, 'F', true);
+    ctx->gpr[0] = -1;
+    break;
+  }
+  }
 
-    if (currentProcesses >= MAX_PROCS) // process table full
-    {
-      print("\nERR: process table full", 24);
+  spin_unlock(&procLock);
 
-      ctx->gpr[0] = -1;
-    }
+  return;
+}
 
-    else
-    {
-      int iNew = currentProcesses;
-      currentProcesses++;
-
-      // search for a terminated process in the table
-      for (int i = 1; i < MAX_PROCS; i++)
-      {
-        if (procTab[i].status == STATUS_TERMINATED)
-        {
-          iNew = i;
-          break;
-        }
-      }
-
-      memset(&procTab[iNew], 0, sizeof(pcb_t)); // initialise 0-th PCB
-
-      procTab[iNew].pid = (pid_t)(iNew);
-      procTab[iNew].status = STATUS_READY;
-      procTab[iNew].tos = (uint32_t)(&tos_p) - (iNew - 1) * 0x00002000;
-
-      memcpy(&procTab[iNew].ctx, ctx, sizeof(ctx_t)); // replicate state of parent - copy execution context
-
-      // set child stack pointer to same height as parent's stack pointer
-      uint32_t stackHeight = executing->tos - executing->ctx.sp;
-      procTab[iNew].ctx.sp = procTab[iNew].tos - stackHeight;
-      memcpy( (uint32_t*) (procTab[ iNew ].ctx.sp), (uint32_t*) ctx->sp , stackHeight);
-
-      procTab[iNew].lastExec = time;                  // time counter reset
-      procTab[iNew].niceness = executing->niceness;   // copy parent niceness
-
-      // copy parent fd table, update open file table reference counts
-      for (int i = 0; i < MAX_FDS; i++)
-      {
-        int fd = executing->fdTab[i];
-        procTab[iNew].fdTab[i] = fd;
-        if (fd >= 0)
-          openFileTab[fd].refCount++;
-      }
-
-      ctx->gpr[0] = procTab[iNew].pid; // parent return value = child PID
-      procTab[iNew].ctx.gpr[0] = 0;    // child return value = 0
-    }
+// 0x0C => sleep( ms )
+void svc_sleep(ctx_t *ctx)
+{
+  uint32_t ms = (uint32_t)ctx->gpr[0];
 
-    break;
+  ctx->gpr[0] = 0;
+
+  spin_lock(&procLock);
+  if (ms > 0)
+  {
+    block(ctx, ms);
   }
+  else // sleep(0) => yield()
+  {
+    executing->yielding = true;
+    schedule(ctx);
+  }
+  spin_unlock(&procLock);
 
-  case 0x04: // 0x04 => exit( x )
+  return;
+}
+
+// 0x0D => read_timed( fd, x, n, ms )
+void svc_read_timed(ctx_t *ctx)
+{
+  int fd = (int)(ctx->gpr[0]);
+  char *x = (char *)(ctx->gpr[1]);
+  int n = (int)(ctx->gpr[2]);
+  uint32_t ms = (uint32_t)ctx->gpr[3];
+
+  if (fd < 3 || fd >= MAX_FDS) // only pipes support blocking reads
   {
-    PL011_putc(UART0, 'X', true);
+    ctx->gpr[0] = -1;
+    return;
+  }
 
-    int x = (int)ctx->gpr[0];
+  spin_lock(&procLock);
+  spin_lock(&fileLock);
 
-    // close fds
-    for (int i = 0; i < MAX_FDS; i++)
-    {
-      int    fd = executing->fdTab[i];
-      pid_t pid = executing->pid;
-      if (fd >= 0)
-        close_fd(fd, pid);
-    }
+  pipe_t *pipe = openFileTab[fd].file;
+  if (pipe == NULL) // fd not open
+  {
+    spin_unlock(&fileLock);
+    spin_unlock(&procLock);
 
-    executing->status = STATUS_TERMINATED;
-    currentProcesses--;
-    schedule(ctx);
+    ctx->gpr[0] = -1;
+    return;
+  }
 
-    break;
+  int i = pipe_read(pipe, x, n);
+  bool wait = (i == 0 && n > 0 && ms > 0);
+  bool wake = (i > 0 && !waitq_empty(&pipe->pollq));
+  if (wait)
+    pipe->waiting++;
+  if (wake) // until pipe_wake, since fd may be closed once fileLock is released
+    pipe->pins++;
+
+  spin_unlock(&fileLock);
+
+  trace(TRACE_PIPE_RD, executing->pid, fd, i);
+
+  ctx->gpr[0] = i; // return value unless a writer completes the read, i.e., 0 if timed out
+
+  if (wait) // block until data arrives, or timeout
+  {
+    executing->waitPipe = pipe;
+    futex_enqueue(executing, (uintptr_t)pipe);
+    block(ctx, ms);
   }
 
-  case 0x05: // 0x05 => exec( x )
+  spin_unlock(&procLock);
+
+  if (wake) // complete blocked polls
+    pipe_wake(pipe);
+
+  return;
+}
+
+// 0x0E => clock_gettime( clk )
+void svc_clock_gettime(ctx_t *ctx)
+{
+  uint64_t ns = clock_read_ns(); // clk is ignored: the only clock is monotonic
+
+  ctx->gpr[0] = (uint32_t)(ns);       // return 64-bit result in r0 (low) ...
+  ctx->gpr[1] = (uint32_t)(ns >> 32); // ... and r1 (high)
+
+  return;
+}
+
+// 0x0F => trace( op, x )
+void svc_trace(ctx_t *ctx)
+{
+  int op = (int)ctx->gpr[0];
+  uint32_t x = (uint32_t)ctx->gpr[1];
+
+  if (op == TRACE_OP_MASK) // select recorded events, returning previous selection
   {
-    PL011_putc(UART0, 'E', true);
+    ctx->gpr[0] = traceMask;
+    traceMask = x;
+  }
+  else if (op == TRACE_OP_DUMP) // drain all recorded events, returning how many
+  {
+    ctx->gpr[0] = trace_drain(INT32_MAX, true);
+  }
+  else
+  {
+    ctx->gpr[0] = -1;
+  }
 
-    ctx->pc = (uint32_t)(ctx->gpr[0]); // replace process image
-    ctx->sp = executing->tos;          // reset stack pointer
+  return;
+}
 
-    break;
+// 0x10 => proc_stats( pid, x )
+void svc_proc_stats(ctx_t *ctx)
+{
+  pid_t pid = (pid_t)ctx->gpr[0];
+  pstats_t *x = (pstats_t *)ctx->gpr[1];
+
+  pcb_t *p = NULL;
+
+  if (pid >= 0 && pid < MAX_PROCS)
+    p = &procTab[pid];
+  else if (pid < 0 && pid >= -MAX_CPUS) // idle process of CPU -1 - pid
+    p = &cpus[-1 - pid].idle;
+
+  if (p == NULL || p->status == STATUS_INVALID)
+  {
+    ctx->gpr[0] = -1;
+  }
+  else
+  {
+    memcpy(x, &p->stats, sizeof(pstats_t)); // a snapshot, so need not be consistent
+    ctx->gpr[0] = p->status;
   }
 
-  case 0x06: // 0x06 => kill( pid, x )
+  return;
+}
+
+// 0x11 => svc_stats( svc, x )
+void svc_svc_stats(ctx_t *ctx)
+{
+  uint32_t svc = (uint32_t)ctx->gpr[0];
+  uint32_t *x = (uint32_t *)ctx->gpr[1];
+
+  if (svc >= MAX_SVCS)
   {
-    PL011_putc(UART0, 'K', true);
+    ctx->gpr[0] = -1;
+    return;
+  }
 
-    pid_t pid = (pid_t)ctx->gpr[0];
-    int x = (int)ctx->gpr[1];
+  uint32_t n = 0;
 
-    // close fds
-    for (int i = 0; i < MAX_FDS; i++)
-    {
-      int    fd = procTab[pid].fdTab[i];
-      if (fd >= 0)
-        close_fd(fd, pid);
-    }
+  for (int i = 0; i < SVC_HIST_BUCKETS; i++) // sum histograms over CPUs
+  {
+    x[i] = 0;
+    for (int j = 0; j < MAX_CPUS; j++)
+      x[i] += svcHist[j][svc][i];
+    n += x[i];
+  }
 
-    procTab[pid].status = STATUS_TERMINATED;
-    currentProcesses--;
+  ctx->gpr[0] = n;
 
-    ctx->gpr[0] = 0;
+  return;
+}
+
+// 0x12 => profile( op, x )
+void svc_profile(ctx_t *ctx)
+{
+  int op = (int)ctx->gpr[0];
+  uint32_t x = (uint32_t)ctx->gpr[1];
 
+  switch (op)
+  {
+  case PROFILE_OP_START: // start sampling every x microseconds
+    profile_start(x);
+    ctx->gpr[0] = 0;
+    break;
+  case PROFILE_OP_STOP:
+    profile_stop();
+    ctx->gpr[0] = 0;
+    break;
+  case PROFILE_OP_DUMP: // stop, then dump histogram to UART0 ...
+    ctx->gpr[0] = profile_dump(false);
+    break;
+  case PROFILE_OP_DISK: // ... or to the disk
+    spin_lock(&diskLock);
+    bcache_sync(); // so no buffered block is written back over the dump
+    ctx->gpr[0] = profile_dump(true);
+    spin_unlock(&diskLock);
+    break;
+  default:
+    ctx->gpr[0] = -1;
     break;
   }
 
-  case 0x07: // 0x07 => nice( pid, x )
+  return;
+}
+
+// 0x13 => getpid()
+void svc_getpid(ctx_t *ctx)
+{
+  ctx->gpr[0] = executing->pid;
+
+  return;
+}
+
+// 0x14 => disk( op, a, x )
+void svc_disk(ctx_t *ctx)
+{
+  int op = (int)ctx->gpr[0];
+  uint32_t a = (uint32_t)ctx->gpr[1];
+  uint8_t *x = (uint8_t *)ctx->gpr[2];
+
+  spin_lock(&diskLock);
+
+  if (diskBlockLen <= 0) // the disk may not have been attached at boot, so query lazily
+    diskBlockLen = disk_get_block_len();
+
+  if (diskBlockLen <= 0)
+    ctx->gpr[0] = -1;
+  else if (op == DISK_OP_LEN)
+    ctx->gpr[0] = diskBlockLen;
+  else if (op == DISK_OP_READ) // from the buffer, iff. not yet written back
+    ctx->gpr[0] = bcache_read(a, x, diskBlockLen) ? DISK_SUCCESS : disk_rd(a, x, diskBlockLen);
+  else if (op == DISK_OP_WRITE && bcache_write(a, x, diskBlockLen))
   {
-    PL011_putc(UART0, 'N', true);
+    work_queue(&diskWork); // write back once the system call returns
+    ctx->gpr[0] = DISK_SUCCESS;
+  }
+  else if (op == DISK_OP_WRITE) // too long to buffer
+    ctx->gpr[0] = disk_wr(a, x, diskBlockLen);
+  else if (op == DISK_OP_SYNC)
+    ctx->gpr[0] = bcache_sync();
+  else
+    ctx->gpr[0] = -1;
 
-    pid_t pid = (pid_t)ctx->gpr[0];
-    int x = (int)ctx->gpr[1];
+  spin_unlock(&diskLock);
 
-    if (x < -19)
-      x = -19;
-    else if (x > 20)
-      x = 20;
+  return;
+}
 
-    procTab[pid].niceness = x;
+// 0x15 => sched_setscheduler( pid, policy, priority )
+void svc_sched_setscheduler(ctx_t *ctx)
+{
+  pid_t pid = (pid_t)ctx->gpr[0];
+  int policy = (int)ctx->gpr[1];
+  int priority = (int)ctx->gpr[2];
+  int r = -1;
 
-    ctx->gpr[0] = x;
+  spin_lock(&procLock);
 
-    break;
+  if (pid >= 0 && pid < MAX_PROCS && procTab[pid].status != STATUS_INVALID && procTab[pid].status != STATUS_TERMINATED)
+    r = sched_set(&procTab[pid], policy, priority);
+
+  spin_unlock(&procLock);
+
+  ctx->gpr[0] = r;
+
+  return;
+}
+
+// 0x16 => group_join( pid, gid )
+void svc_group_join(ctx_t *ctx)
+{
+  pid_t pid = (pid_t)ctx->gpr[0];
+  int gid = (int)ctx->gpr[1];
+  int r = -1;
+
+  spin_lock(&procLock);
+
+  if (pid >= 0 && pid < MAX_PROCS && procTab[pid].status != STATUS_INVALID && procTab[pid].status != STATUS_TERMINATED && gid >= 0 && gid < MAX_GROUPS)
+  {
+    group_move(&procTab[pid], gid);
+    r = 0;
   }
 
-  case 0x08: // 0x08 => pipe( pipedes[2] )
+  spin_unlock(&procLock);
+
+  ctx->gpr[0] = r;
+
+  return;
+}
+
+// 0x17 => group_quota( gid, quota, period )
+void svc_group_quota(ctx_t *ctx)
+{
+  int gid = (int)ctx->gpr[0];
+  uint32_t quota = ctx->gpr[1];  // ms
+  uint32_t period = ctx->gpr[2]; // ms
+  int r = -1;
+
+  // group 0 (which includes the console) cannot be limited; a quota may exceed the period iff. there are several CPUs
+  if (gid > 0 && gid < MAX_GROUPS && period > 0 && period <= GROUP_MAX_PERIOD && quota <= period * MAX_CPUS)
   {
-    int *pipedes = (int *)ctx->gpr[0];
+    spin_lock(&procLock);
+    group_limit(gid, quota * (CLOCK_HZ / 1000), period);
+    spin_unlock(&procLock);
+    r = 0;
+  }
 
-    pipe_t *p = malloc(sizeof(pipe_t)); // initialise pipe struct
-    p->front = 0;
-    p->rear = -1;
-    p->size = sizeof(p->buffer);
-    p->full = false;
+  ctx->gpr[0] = r;
 
-    int fd_read = open_fd(p, RDONLY); // open read end
+  return;
+}
 
-    int fd_write = open_fd(p, WRONLY); // open write end
+// 0x18 => group_stats( gid, x )
+void svc_group_stats(ctx_t *ctx)
+{
+  int gid = (int)ctx->gpr[0];
+  gstats_t *x = (gstats_t *)ctx->gpr[1];
+  int r = -1;
 
-    if (fd_read == -1 || fd_write == -1) // pipe creation failed
+  if (gid >= 0 && gid < MAX_GROUPS)
+  {
+    group_t *g = &groups[gid];
+
+    x->quota = g->quota / (CLOCK_HZ / 1000); // a snapshot, so need not be consistent
+    x->period = g->period;
+    x->usedCycles = g->usedTotal;
+    x->throttles = g->throttles;
+    x->throttled = g->throttled;
+
+    r = 0;
+    for (int i = 0; i < MAX_PROCS; i++)
     {
-      print("\npipe failed", 12);
-      pid_t pid = executing->pid;
-      if (fd_read >= 0)
-        close_fd(fd_read, pid);
-      if (fd_write >= 0)
-        close_fd(fd_write, pid);
-
-      ctx->gpr[0] = -1; // failure
+      if (procTab[i].group == gid && procTab[i].status != STATUS_INVALID && procTab[i].status != STATUS_TERMINATED)
+        r++;
     }
+  }
 
-    else
-    {
-      int pipefds[2];
-      pipefds[0] = fd_read;
-      pipefds[1] = fd_write;
-      memcpy(pipedes, pipefds, 2 * sizeof(int)); // return fd indices
+  ctx->gpr[0] = r;
+
+  return;
+}
 
-      ctx->gpr[0] = 0; // success
+// 0x19 => readv( fd, iov, iovcnt )
+void svc_readv(ctx_t *ctx)
+{
+  int fd = (int)(ctx->gpr[0]);
+  iovec_t *iov = (iovec_t *)(ctx->gpr[1]);
+  int iovcnt = (int)(ctx->gpr[2]);
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+  {
+    ctx->gpr[0] = -1;
+    return;
+  }
+
+  pipe_t *wake = NULL;
+  int r = 0;
+
+  for (int i = 0; i < iovcnt; i++) // scatter, stopping at the first short read
+  {
+    int n = file_read(fd, iov[i].base, (int)iov[i].len, &wake);
+    if (n < 0)
+    {
+      r = (r > 0) ? r : -1;
+      break;
     }
 
-    break;
+    r += n;
+    if (n < (int)iov[i].len)
+      break;
   }
 
-  case 0x09: // close( fd )
+  if (wake != NULL) // complete blocked polls, once for all buffers
+    pipe_wake(wake);
+
+  ctx->gpr[0] = r;
+
+  return;
+}
+
+// 0x1A => writev( fd, iov, iovcnt )
+void svc_writev(ctx_t *ctx)
+{
+  int fd = (int)(ctx->gpr[0]);
+  iovec_t *iov = (iovec_t *)(ctx->gpr[1]);
+  int iovcnt = (int)(ctx->gpr[2]);
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
   {
-    int fd = (int)ctx->gpr[0];
+    ctx->gpr[0] = -1;
+    return;
+  }
 
-    pid_t pid = executing->pid;
+  pipe_t *wake = NULL;
+  int r = 0;
 
-    ctx->gpr[0] = close_fd(fd, pid);
+  for (int i = 0; i < iovcnt; i++) // gather, stopping at the first short write
+  {
+    int n = file_write(fd, iov[i].base, (int)iov[i].len, &wake);
+    if (n < 0)
+    {
+      r = (r > 0) ? r : -1;
+      break;
+    }
 
-    break;
+    r += n;
+    if (n < (int)iov[i].len)
+      break;
   }
 
-  default: // 0x?? => unknown/unsupported
+  if (wake != NULL) // complete blocked reads, once for all buffers
+    pipe_wake(wake);
+
+  ctx->gpr[0] = r;
+
+  return;
+}
+
+// 0x1B => pread( fd, x, n, off )
+void svc_pread(ctx_t *ctx)
+{
+  // every file is a stream (i.e., the console or a pipe), so has no position to read at
+  ctx->gpr[0] = -1;
+
+  return;
+}
+
+// 0x1C => pwrite( fd, x, n, off )
+void svc_pwrite(ctx_t *ctx)
+{
+  // every file is a stream (i.e., the console or a pipe), so has no position to write at
+  ctx->gpr[0] = -1;
+
+  return;
+}
+
+// 0x1D => poll( fds, nfds, ms )
+void svc_poll(ctx_t *ctx)
+{
+  pollfd_t *fds = (pollfd_t *)(ctx->gpr[0]);
+  int nfds = (int)(ctx->gpr[1]);
+  uint32_t ms = (uint32_t)ctx->gpr[2];
+
+  if (nfds < 0 || nfds > POLL_MAX)
   {
-    break;
+    ctx->gpr[0] = -1;
+    return;
   }
+
+  spin_lock(&procLock);
+  spin_lock(&fileLock);
+
+  int r = poll_scan(fds, nfds);
+  bool wait = (r == 0 && ms > 0);
+  if (wait) // enqueue before releasing fileLock, so no change to a pipe is missed
+    poll_enqueue(fds, nfds);
+
+  spin_unlock(&fileLock);
+
+  ctx->gpr[0] = r; // return value unless a change completes the poll, i.e., 0 if timed out
+
+  if (wait) // block until an fd is ready, or timeout
+    block(ctx, ms);
+
+  spin_unlock(&procLock);
+
+  return;
+}
+
+/* Fast system call handlers, invoked by the low-level SVC handler without
+ * preserving the execution context (see lolevel.s): each one is a leaf, i.e.,
+ * it may not block, switch context, or otherwise use the execution context,
+ * and it is not traced or timed (though it is counted).  The arguments are
+ * passed, and the result returned (in r0, plus r1 for a 64-bit result), per
+ * the AAPCS.
+ */
+
+// 0x0E => clock_gettime( clk )
+uint64_t svc_clock_gettime_fast(uint32_t clk, uint32_t b, uint32_t c, uint32_t d)
+{
+  executing->stats.svcCount[0x0E]++;
+
+  return clock_read_ns(); // clk is ignored: the only clock is monotonic
+}
+
+// 0x13 => getpid()
+uint64_t svc_getpid_fast(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+  executing->stats.svcCount[0x13]++;
+
+  return executing->pid;
+}
+
+// system call handlers, indexed by ID: NULL iff. unused
+svc_t svcTab[MAX_SVCS] = {
+    [0x00] = {&svc_yield, 0},
+    [0x01] = {&svc_write, 3},
+    [0x02] = {&svc_read, 3},
+    [0x03] = {&svc_fork, 0},
+    [0x04] = {&svc_exit, 1},
+    [0x05] = {&svc_exec, 1},
+    [0x06] = {&svc_kill, 2},
+    [0x07] = {&svc_nice, 2},
+    [0x08] = {&svc_pipe, 1},
+    [0x09] = {&svc_close, 1},
+    [0x0B] = {&svc_futex, 4},
+    [0x0C] = {&svc_sleep, 1},
+    [0x0D] = {&svc_read_timed, 4},
+    [0x0E] = {&svc_clock_gettime, 1},
+    [0x0F] = {&svc_trace, 2},
+    [0x10] = {&svc_proc_stats, 2},
+    [0x11] = {&svc_svc_stats, 2},
+    [0x12] = {&svc_profile, 2},
+    [0x13] = {&svc_getpid, 0},
+    [0x14] = {&svc_disk, 3},
+    [0x15] = {&svc_sched_setscheduler, 3},
+    [0x16] = {&svc_group_join, 2},
+    [0x17] = {&svc_group_quota, 3},
+    [0x18] = {&svc_group_stats, 2},
+    [0x19] = {&svc_readv, 3},
+    [0x1A] = {&svc_writev, 3},
+    [0x1B] = {&svc_pread, 4},
+    [0x1C] = {&svc_pwrite, 4},
+    [0x1D] = {&svc_poll, 3},
+};
+
+// fast system call handlers, indexed by ID: NULL iff. the system call has none, so is handled by hilevel_handler_svc
+svc_fast_t svcFast[MAX_SVCS] = {
+    [0x0E] = &svc_clock_gettime_fast,
+    [0x13] = &svc_getpid_fast,
+};
+
+// Supervisor call handler
+void hilevel_handler_svc(ctx_t *ctx, uint32_t id)
+{
+  /* Based on the identifier (i.e., r7, per the EABI) invoke the handler
+   * in svcTab, if any: the low-level handler has already invoked the fast
+   * handler in svcFast, if any, instead.
+   */
+
+  pcb_t *self = executing; // calling process, charged for the system call
+  svc_t *svc = (id < MAX_SVCS && svcTab[id].fn != NULL) ? &svcTab[id] : NULL;
+
+  acct_charge(&self->stats.userCycles);
+  if (id < MAX_SVCS)
+    self->stats.svcCount[id]++;
+
+  trace(TRACE_SVC, executing->pid, id, (svc != NULL && svc->nargs > 0) ? ctx->gpr[0] : 0);
+
+  if (executing->status == STATUS_TERMINATED) // killed by another CPU, so switch away
+  {
+    schedule(ctx);
+    acct_charge(&self->stats.kernelCycles);
+
+    return;
   }
 
+  if (svc != NULL) // else unknown/unsupported
+    svc->fn(ctx);
+
+  irq_bh_kick(); // execute any work the system call deferred before returning to USR mode
+
+  uint32_t t = acct_charge(&self->stats.kernelCycles);
+  if (id < MAX_SVCS)
+    svc_record(id, t);
+
   return;
 }
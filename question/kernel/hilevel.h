@@ -23,73 +23,63 @@
 #include   "GIC.h"
 #include "PL011.h"
 #include "SP804.h"
+#include   "SYS.h"
+#include  "disk.h"
 
 // Include functionality relating to the   kernel.
 
 #include "lolevel.h"
 #include     "int.h"
+#include     "irq.h"
+#include  "bcache.h"
+#include     "smp.h"
+#include   "timer.h"
+#include   "clock.h"
+#include   "trace.h"
+#include     "pmu.h"
+#include "profile.h"
 
-/* The kernel source code is made simpler and more consistent by using 
- * some human-readable type definitions:
- *
- * - a type that captures a Process IDentifier (PID), which is really
- *   just an integer,
- * - an enumerated type that captures the status of a process, e.g.,
- *   whether it is currently executing,
- * - a type that captures each component of an execution context (i.e.,
- *   processor state) in a compatible order wrt. the low-level handler
- *   preservation and restoration prologue and epilogue, and
- * - a type that captures a process PCB.
- */
+#include     "hal.h"
+#include    "proc.h"
 
-#define MAX_PROCS 100
-#define MAX_FDS 128
-#define BUFFER_SIZE 9
+#define IPI_RESCHED GIC_SOURCE_SGI0 // SGI asking a core to invoke the scheduler
+#define IPI_TICK (GIC_SOURCE_SGI0 + 3) // SGI asking a core to handle the rest of a scheduler tick
 
-typedef int pid_t;
+#define TICK_SLOW_PERIOD 8 // scheduler ticks between those always handled in full (e.g., to extend the clock)
 
-typedef enum { 
-  STATUS_INVALID,
+// a system call handler, plus its number of arguments (in r0...r3)
+typedef struct {
+  void (*fn)(ctx_t *ctx);
+  int nargs;
+} svc_t;
 
-  STATUS_CREATED,
-  STATUS_TERMINATED,
+// a fast system call handler, i.e., invoked with the arguments rather than the execution context, returning the result
+typedef uint64_t (*svc_fast_t)(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
 
-  STATUS_READY,
-  STATUS_EXECUTING,
-  STATUS_WAITING
-} status_t;
+#define SVC_HIST_BUCKETS 24 // latency histogram buckets, i.e., [2^i, 2^(i+1)) cycles for bucket i
 
-typedef enum {
-  RDONLY,
-  WRONLY,
-  RDWR
-} fdstatus_t;
+#define DISK_OP_LEN 0   // query the block length
+#define DISK_OP_READ 1  // read  a block
+#define DISK_OP_WRITE 2 // write a block
+#define DISK_OP_SYNC 3  // write back every buffered block
 
-typedef struct {
-  uint32_t cpsr, pc, gpr[ 13 ], sp, lr;
-} ctx_t;
+#define IOV_MAX 16 // maximum number of buffers per readv or writev
 
+// a buffer of readv or writev
 typedef struct {
-  char buffer[BUFFER_SIZE];
-  int  front, rear, size;
-  bool full;
-} pipe_t;
+    char* base; // address
+uint32_t   len; // length (in bytes)
+} iovec_t;
 
-typedef struct {
-  pipe_t*    file;
-  fdstatus_t flag;
-  int        refCount;
-} fd_t;
+#define GROUP_MAX_PERIOD 10000 // maximum period (in ms) of a process group quota
 
+// usage of a process group, as read by group_stats
 typedef struct {
-   pid_t            pid; // Process IDentifier (PID)
-status_t         status; // current status
-uint32_t            tos; // address of Top of Stack (ToS)
-   ctx_t            ctx; // execution context
-uint32_t       lastExec; // time of last execution
-uint32_t       niceness; // base priority value
-     int fdTab[MAX_FDS]; // process file descriptor table
-} pcb_t;
-
+uint32_t      quota; // CPU time (in ms) per period, 0 if unlimited
+uint32_t     period; // period (in ms)
+uint64_t usedCycles; // CPU time used in total
+uint32_t  throttles; // number of periods in which its quota was used up
+uint32_t  throttled; // non-zero iff. its quota is used up in the current period
+} gstats_t;
 
 #endif
@@ -0,0 +1,195 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "irq.h"
+
+irq_t             irqTab[ GIC_SOURCES ];
+ctx_t*            irqCtx[ MAX_CPUS ]; // execution context of the process interrupted by the outermost handler, per CPU
+
+irq_bh_t          irqBh[ BH_MAX ];
+volatile uint32_t irqBhPending[ MAX_CPUS ]; // bottom halves raised, per CPU
+
+work_t*           workHead[ MAX_CPUS ]; // queue of work items, per CPU
+work_t*           workTail[ MAX_CPUS ];
+
+bool irq_groups() {
+  return ( GICD0->TYPER & ( 1 << 10 ) ) != 0; // SecurityExtn, without which IGROUPR is RAZ/WI
+}
+
+// send an SGI, per x as written to SGIR: each SGI used is in group 1 (if the GIC supports groups), which it forwards from the Secure state only if NSATT is set
+void irq_sgi( uint32_t x ) {
+  if( irq_groups() ) {
+    x |= 1 << 15; // NSATT
+  }
+
+  GICD0->SGIR = x;
+}
+
+// place interrupt id in group 0 (i.e., FIQ) iff. registered as such, and otherwise group 1 (i.e., IRQ)
+void irq_group( uint32_t id ) {
+  if( !irq_groups() ) { // every source is signalled as IRQ
+    return;
+  }
+
+  if( irqTab[ id ].flags & IRQ_FIQ ) {
+    ( &GICD0->IGROUPR0 )[ id / 32 ] &= ~( 1 << ( id % 32 ) );
+  }
+  else {
+    ( &GICD0->IGROUPR0 )[ id / 32 ] |=  ( 1 << ( id % 32 ) );
+  }
+}
+
+void irq_register( uint32_t id, uint8_t pri, uint8_t flags, irq_handler_t fn ) {
+  irqTab[ id ].fn    = fn;
+  irqTab[ id ].pri   = pri;
+  irqTab[ id ].flags = flags;
+
+  ( ( volatile uint8_t* )( GICD0->IPRIORITYR ) )[ id ] = pri;
+
+  irq_group( id );
+
+  if( id >= 32 ) { // an SPI, so route it to this CPU (whereas SGIs and PPIs are banked, i.e., per CPU)
+    ( ( volatile uint8_t* )( GICD0->ITARGETSR ) )[ id ] |= 1 << cpu_id();
+  }
+
+  ( &GICD0->ISENABLER0 )[ id / 32 ] = 1 << ( id % 32 );
+}
+
+void irq_init_cpu() {
+  for( uint32_t id = 0; id < 32; id++ ) {
+    if( irqTab[ id ].fn != NULL ) {
+      ( ( volatile uint8_t* )( GICD0->IPRIORITYR ) )[ id ] = irqTab[ id ].pri;
+      irq_group( id );
+      GICD0->ISENABLER0 = 1 << id;
+    }
+  }
+
+  GICC0->PMR  = IRQ_PRI_MASK; // unmask interrupts of every priority we use
+  if( irq_groups() ) {
+    GICC0->CTLR = 0x0000000F; // enable GIC interface, for both groups, signalling group 0 as FIQ (AckCtl set, so IAR acknowledges group 1)
+  }
+  else {
+    GICC0->CTLR = 0x00000001; // enable GIC interface
+  }
+}
+
+void irq_handle( ctx_t* ctx ) {
+  // Read  the interrupt identifier so we know the source (an SGI also has the source CPU ID in bits 12:10).
+  uint32_t iar = GICC0->IAR;
+  uint32_t id  = iar & 0x3FF;
+
+  if( id >= GIC_SOURCES ) { // spurious, e.g., since it was handled by another CPU: there is nothing to signal
+    return;
+  }
+
+  if( ctx != NULL ) {
+    irqCtx[ cpu_id() ] = ctx;
+  }
+
+  trace( TRACE_IRQ, executing->pid, id, ctx == NULL );
+
+  irq_t* x = &irqTab[ id ];
+
+  if( x->fn != NULL ) { // else not registered, so just signal we're done
+    x->fn( irqCtx[ cpu_id() ], id );
+  }
+
+  // Write the interrupt identifier to signal we're done.
+  GICC0->EOIR = iar;
+}
+
+void irq_bh_register( int n, irq_bh_t fn ) {
+  irqBh[ n ] = fn;
+}
+
+void irq_bh_raise( int n ) {
+  uint32_t x = int_save_irq(); // may be raised with IRQ interrupts enabled, so update atomically wrt. this CPU
+
+  irqBhPending[ cpu_id() ] |= 1 << n;
+
+  int_restore_irq( x );
+}
+
+// execute each bottom half in x
+void irq_bh_exec( void* ctx, uint32_t x ) {
+  for( int n = 0; n < BH_MAX; n++ ) {
+    if( ( x & ( 1 << n ) ) && ( irqBh[ n ] != NULL ) ) {
+      irqBh[ n ]();
+    }
+  }
+}
+
+/* A bottom half raised again while bottom halves are executing is executed
+ * again, but only up to BH_RESTART times: any still raised after that are
+ * left until the next interrupt, so a bottom half that keeps raising itself
+ * (or a flood of interrupts) can not starve the interrupted process.
+ */
+
+void irq_bh_run() {
+  volatile uint32_t* pending = &irqBhPending[ cpu_id() ];
+
+  for( int i = 0; ( i < BH_RESTART ) && ( *pending != 0 ); i++ ) {
+    uint32_t x = *pending; *pending = 0; // IRQ interrupts are disabled, so this is atomic wrt. this CPU
+
+    lolevel_nest( &irq_bh_exec, NULL, x );
+  }
+}
+
+void irq_bh_kick() {
+  if( irqBhPending[ cpu_id() ] != 0 ) {
+    irq_sgi( 0x02000000 | IPI_SOFTIRQ ); // target list = this CPU only
+  }
+}
+
+void work_queue( work_t* x ) {
+  if( __atomic_exchange_n( &x->queued, true, __ATOMIC_ACQ_REL ) ) { // already queued, maybe by another CPU
+    return;
+  }
+
+  uint32_t cpsr = int_save_irq(); int cpu = cpu_id();
+
+  x->next = NULL;
+
+  if( workHead[ cpu ] == NULL ) {
+    workHead[ cpu ]       = x;
+  }
+  else {
+    workTail[ cpu ]->next = x;
+  }
+
+  workTail[ cpu ] = x;
+
+  irqBhPending[ cpu ] |= 1 << BH_WORK;
+
+  int_restore_irq( cpsr );
+}
+
+/* The queue is detached before any item is executed, so an item queued
+ * while they execute (including by an item itself) is executed only once
+ * BH_WORK is executed again (see irq_bh_run).
+ */
+
+void work_run() {
+  uint32_t cpsr = int_save_irq(); int cpu = cpu_id();
+
+  work_t* x = workHead[ cpu ];
+
+  workHead[ cpu ] = NULL;
+  workTail[ cpu ] = NULL;
+
+  int_restore_irq( cpsr );
+
+  while( x != NULL ) {
+    work_t* next = x->next;
+
+    __atomic_store_n( &x->queued, false, __ATOMIC_RELEASE ); // may be queued again once it starts executing
+
+    x->fn( x );
+
+    x = next;
+  }
+}
@@ -0,0 +1,119 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __IRQ_H
+#define __IRQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include   "GIC.h"
+
+#include "lolevel.h"
+#include     "int.h"
+#include     "smp.h"
+#include   "trace.h"
+
+#include    "proc.h"
+
+/* Each interrupt source of GIC0 which is used has a handler registered in
+ * a table, with a priority: of the interrupts pending, the GIC signals the
+ * one of highest (i.e., numerically lowest) priority first.  A handler
+ * executes with IRQ interrupts disabled, so is never itself interrupted by
+ * an IRQ (every handler being short): only bottom halves and work items
+ * (see below) execute with IRQ interrupts enabled.  An IRQ which interrupts
+ * one is handled via hilevel_handler_nest, and its handler is given the
+ * execution context of the process interrupted by the outermost handler.
+ *
+ * A handler can also raise a bottom half, i.e., defer work until every
+ * handler has finished.  Once the outermost handler has signalled the end
+ * of the interrupt, the bottom halves raised on that CPU are executed, in
+ * order of number, with IRQ interrupts enabled.
+ *
+ * Work can also be deferred as a work item, i.e., a function queued on the
+ * CPU which queued it: a bottom half executes the queued items, in order,
+ * with IRQ interrupts enabled.  An item is executed once however many times
+ * it is queued before it starts executing, so it is safe to queue the same
+ * item from several handlers (or CPUs).  Bottom halves raised by a system
+ * call (e.g., by queueing work) are executed on return to USR mode, since
+ * the SVC handler then interrupts its own CPU via IPI_SOFTIRQ.
+ *
+ * A source registered with IRQ_FIQ is placed in group 0, which the GIC
+ * signals as an FIQ rather than an IRQ (every other source being placed in
+ * group 1): it is handled by lolevel_handler_fiq rather than via the table,
+ * unless the GIC does not support groups (per irq_groups, as for the GIC
+ * QEMU models on both boards), in which case it is signalled as an IRQ like
+ * any other and so handled by its registered handler.  Every SGI is sent via
+ * irq_sgi, so is forwarded whether or not the GIC supports groups; the path
+ * via groups is untested, since neither QEMU board models them.
+ *
+ * Since a handler never switches context itself (it sets needResched, so
+ * the scheduler is invoked on return to USR mode), and code executed with
+ * IRQ interrupts enabled (i.e., bottom halves and work items) may be
+ * interrupted on the same CPU, the latter must not acquire any spinlock that
+ * a handler may, other than via spin_trylock.
+ */
+
+#define GIC_SOURCES   ( 96 ) // interrupt IDs, i.e., SGIs, PPIs and SPIs, of GIC0
+
+#define IRQ_PRI_FIQ   ( 0x00 ) // priority of FIQ sources, so they are signalled during any handler
+#define IRQ_PRI_TIMER ( 0x20 ) // priority of the timer tick
+#define IRQ_PRI_IPI   ( 0x40 ) // priority of IPIs
+#define IRQ_PRI_DEV   ( 0x80 ) // priority of other devices
+#define IRQ_PRI_MASK  ( 0xF0 ) // priority mask, i.e., lowest priority signalled
+
+#define IRQ_FIQ       ( 1 << 0 ) // source signalled as FIQ
+
+#define IPI_SOFTIRQ   ( GIC_SOURCE_SGI0 + 2 ) // SGI asking a core to execute its bottom halves
+
+#define BH_TRACE      ( 0 ) // bottom half: drain the trace
+#define BH_WORK       ( 1 ) // bottom half: execute queued work items
+#define BH_MAX        ( 8 )
+#define BH_RESTART    ( 4 ) // times bottom halves are re-executed if raised again while executing
+
+typedef void ( *irq_handler_t )( ctx_t* ctx, uint32_t id );
+typedef void ( *irq_bh_t      )();
+
+typedef struct work {
+  void ( *fn )( struct work* x ); // function invoked to execute the item
+  struct work*   next; // next item queued on the same CPU, NULL if last
+  volatile bool queued; // queued, but not yet executing
+} work_t;
+
+typedef struct {
+  irq_handler_t fn; // handler, NULL if none
+  uint8_t      pri; // priority
+  uint8_t    flags; // IRQ_FIQ, or 0
+} irq_t;
+
+// true iff. the GIC supports interrupt groups, so can signal group 0 (i.e., IRQ_FIQ sources) as FIQ
+extern bool irq_groups();
+extern void irq_sgi( uint32_t x );
+// register handler fn, with priority pri and flags, for interrupt id (then enable it, routed to this CPU)
+extern void irq_register( uint32_t id, uint8_t pri, uint8_t flags, irq_handler_t fn );
+// initialise the GIC interface of this CPU, plus its banked (i.e., SGI and PPI) priorities and enables
+extern void irq_init_cpu();
+
+// acknowledge then handle an interrupt, where ctx is that of the interrupted process, or NULL iff. the interrupt is nested
+extern void irq_handle( ctx_t* ctx );
+
+// register bottom half n as fn
+extern void irq_bh_register( int n, irq_bh_t fn );
+// raise bottom half n on this CPU
+extern void irq_bh_raise( int n );
+// execute bottom halves raised on this CPU, with IRQ interrupts enabled; invoked by the outermost handler
+extern void irq_bh_run();
+// ensure bottom halves raised on this CPU outside an interrupt handler are executed, by interrupting it via IPI_SOFTIRQ
+extern void irq_bh_kick();
+
+// queue work item x on this CPU, unless it is already queued
+extern void work_queue( work_t* x );
+// execute the work items queued on this CPU; registered as bottom half BH_WORK
+extern void work_run();
+
+#endif
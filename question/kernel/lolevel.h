@@ -8,4 +8,19 @@
 #ifndef __LOLEVEL_H
 #define __LOLEVEL_H
 
+#include <stdint.h>
+
+// low-level interrupt handlers
+extern void lolevel_handler_rst();
+extern void lolevel_handler_sec();
+extern void lolevel_handler_irq();
+extern void lolevel_handler_svc();
+extern void lolevel_handler_fiq();
+
+// invoke fn( x, y ) in SVC mode with IRQ interrupts enabled (see irq.h)
+extern void lolevel_nest( void ( *fn )( void* x, uint32_t y ), void* x, uint32_t y );
+
+// idle loop, executed in USR mode by a core with no process to execute
+extern void lolevel_idle();
+
 #endif
@@ -8,14 +8,56 @@
 /* Each of the following is a low-level interrupt handler: each one is
  * tasked with handling a different interrupt type, and acts as a sort
  * of wrapper around a high-level, C-based handler.
+ *
+ * Before returning to USR mode, the IRQ and SVC handlers check the flag
+ * needResched (see proc.h) of the executing core: if a high-level handler
+ * made ready a process which should preempt the executing one, it is set,
+ * so the scheduler is invoked via hilevel_handler_resched at once rather
+ * than on the next timer tick.
+ *
+ * Interrupts may nest, since bottom halves execute with IRQ interrupts
+ * enabled (see irq.h): an IRQ which interrupts a mode other than USR
+ * preserves only the caller-saved registers (plus those the string
+ * functions use) and the return state, invokes hilevel_handler_nest, then
+ * returns to wherever it interrupted; it never reschedules, since only the
+ * outermost handler has a USR execution context to switch.
+ *
+ * The SVC handler has a fast path: the system call ID is passed in r7 (per
+ * the EABI, so the svc instruction need not be read), and if svcFast (see
+ * hilevel.c) has a fast handler for it, it is invoked with only the
+ * caller-saved registers preserved, and returns directly to USR mode with
+ * the result in r0 (and r1).  Otherwise, the full execution context is
+ * preserved and hilevel_handler_svc invoked as usual.
+ *
+ * The FIQ handler is a fast path for the scheduler tick, which can interrupt
+ * any other handler: since FIQ mode banks r8-r12, it preserves only r0-r3
+ * and the return address, then invokes hilevel_handler_fiq, which counts
+ * the tick and, iff. there is more to do, passes it on as an IRQ (see
+ * hilevel.c).
+ *
+ * Each core enables the VFP/NEON unit on reset.  If the NEON variants of
+ * the string functions are selected (see memops.s), the registers they
+ * use (d0...d7) are preserved as part of the execution context, directly
+ * above the USR mode registers.
  */
 
+.fpu neon
+
 .global lolevel_handler_rst
+.global lolevel_handler_sec
 .global lolevel_handler_irq
 .global lolevel_handler_svc
+.global lolevel_handler_fiq
+
+.global lolevel_nest
+
+.global lolevel_idle
 
 lolevel_handler_rst: bl    int_init                @ initialise interrupt vector table
+                     bl    lolevel_neon            @ enable VFP/NEON
 
+                     msr   cpsr, #0xD1             @ enter FIQ mode with IRQ and FIQ interrupts disabled
+                     ldr   sp, =tos_fiq            @ initialise FIQ mode stack
                      msr   cpsr, #0xD2             @ enter IRQ mode with IRQ and FIQ interrupts disabled
                      ldr   sp, =tos_irq            @ initialise IRQ mode stack
                      msr   cpsr, #0xD3             @ enter SVC mode with IRQ and FIQ interrupts disabled
@@ -28,10 +70,59 @@ lolevel_handler_rst: bl    int_init                @ initialise interrupt vector
                      msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   SVC mode SP
+.if STRING_IMPL == 2
+                     vpop  { d0-d7 }               @ restore  USR NEON registers
+.endif
+                     movs  pc, lr                  @ return from interrupt
+                     b     .                       @ halt
+
+/* Secondary cores are released (by the primary core) from the boot loader
+ * to here; each one is allocated IRQ and SVC mode stacks offset by its ID.
+ */
+
+lolevel_handler_sec: bl    lolevel_neon            @ enable VFP/NEON
+
+                     mrc   p15, 0, r4, c0, c0, 5   @ read  MPIDR
+                     and   r4, r4, #0x3            @ extract CPU ID
+                     mov   r4, r4, lsl #13         @ compute stack offset = ID * 0x2000
+
+                     msr   cpsr, #0xD1             @ enter FIQ mode with IRQ and FIQ interrupts disabled
+                     ldr   sp, =tos_fiq            @ initialise FIQ mode stack
+                     sub   sp, sp, r4, lsr #3      @ (offset by ID * 0x400)
+                     msr   cpsr, #0xD2             @ enter IRQ mode with IRQ and FIQ interrupts disabled
+                     ldr   sp, =tos_irq            @ initialise IRQ mode stack
+                     sub   sp, sp, r4              
+                     msr   cpsr, #0xD3             @ enter SVC mode with IRQ and FIQ interrupts disabled
+                     ldr   sp, =tos_svc            @ initialise SVC mode stack
+                     sub   sp, sp, r4
+                     sub   sp, sp, #68             @ allocate execution context
+.if STRING_IMPL == 2
+                     sub   sp, sp, #64             @ allocate execution context NEON registers
+.endif
+
+                     mov   r0, sp                  @ set    high-level C function arg. = SP
+                     bl    hilevel_handler_sec     @ invoke high-level C function
+
+                     ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
+                     msr   spsr, r0                @ move     USR mode        CPSR
+                     ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
+                     add   sp, sp, #60             @ update   SVC mode SP
+.if STRING_IMPL == 2
+                     vpop  { d0-d7 }               @ restore  USR NEON registers
+.endif
                      movs  pc, lr                  @ return from interrupt
                      b     .                       @ halt
 
 lolevel_handler_irq: sub   lr, lr, #4              @ correct return address
+                     push  { r0 }                  @ preserve r0
+                     mrs   r0, spsr                @ move     interrupted CPSR
+                     and   r0, r0, #0x1F           @ extract  interrupted mode
+                     cmp   r0, #0x10               @ interrupted USR mode?
+                     pop   { r0 }                  @ restore  r0
+                     bne   lolevel_irq_nest        @ if not, nested
+.if STRING_IMPL == 2
+                     vpush { d0-d7 }               @ preserve USR NEON registers
+.endif
                      sub   sp, sp, #60             @ update   IRQ mode stack
                      stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
                      mrs   r0, spsr                @ move     USR        CPSR
@@ -39,27 +130,138 @@ lolevel_handler_irq: sub   lr, lr, #4              @ correct return address
 
                      mov   r0, sp                  @ set    high-level C function arg. = SP
                      bl    hilevel_handler_irq     @ invoke high-level C function
+                     bl    lolevel_resched         @ invoke scheduler iff. needed
         
                      ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
                      msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   IRQ mode SP
+.if STRING_IMPL == 2
+                     vpop  { d0-d7 }               @ restore  USR NEON registers
+.endif
                      movs  pc, lr                  @ return from interrupt	
 
+lolevel_irq_nest:    push  { r0-r3, r12, lr }      @ preserve caller-saved registers and return address
+.if STRING_IMPL == 2
+                     vpush { d0-d7 }               @ preserve NEON registers
+.endif
+                     mrs   r0, spsr                @ move     interrupted CPSR
+                     push  { r0, r1 }              @ store    interrupted CPSR (r1 keeps SP 8-byte aligned)
+
+                     bl    hilevel_handler_nest    @ invoke high-level C function
+
+                     pop   { r0, r1 }              @ load     interrupted CPSR
+                     msr   spsr_cxsf, r0           @ move     interrupted CPSR
+.if STRING_IMPL == 2
+                     vpop  { d0-d7 }               @ restore  NEON registers
+.endif
+                     ldmia sp!, { r0-r3, r12, pc }^ @ restore registers, and return from interrupt
+
 
-lolevel_handler_svc: sub   lr, lr, #0              @ correct return address
+lolevel_handler_svc: push  { r0-r3, r12, lr }      @ preserve caller-saved USR registers and return address
+                     cmp   r7, #MAX_SVCS           @ system call ID < MAX_SVCS (see proc.h)?
+                     bhs   lolevel_svc_slow        @ unknown ID => full context
+                     ldr   r12, =svcFast           @ load  address of fast handlers
+                     ldr   r12, [ r12, r7, lsl #2 ] @ load  fast handler for ID
+                     cmp   r12, #0
+                     beq   lolevel_svc_slow        @ no fast handler => full context
+                     blx   r12                     @ invoke high-level C function, result in r0 (and r1)
+                     add   sp, sp, #8              @ discard  USR mode r0 and r1
+                     pop   { r2-r3, r12, lr }      @ restore  USR mode r2, r3, r12, and return address
+                     movs  pc, lr                  @ return from interrupt
+
+lolevel_svc_slow:    pop   { r0-r3, r12, lr }      @ restore  USR mode registers and return address
+.if STRING_IMPL == 2
+                     vpush { d0-d7 }               @ preserve USR NEON registers
+.endif
                      sub   sp, sp, #60             @ update   SVC mode stack
                      stmia sp, { r0-r12, sp, lr }^ @ preserve USR registers
                      mrs   r0, spsr                @ move     USR        CPSR
                      stmdb sp!, { r0, lr }         @ store    USR PC and CPSR
          
                      mov   r0, sp                  @ set    high-level C function arg. = SP
-                     ldr   r1, [ lr, #-4 ]         @ load                     svc instruction
-                     bic   r1, r1, #0xFF000000     @ set    high-level C function arg. = svc immediate
+                     mov   r1, r7                  @ set    high-level C function arg. = system call ID
                      bl    hilevel_handler_svc     @ invoke high-level C function
+                     bl    lolevel_resched         @ invoke scheduler iff. needed
         
                      ldmia sp!, { r0, lr }         @ load     USR mode PC and CPSR
                      msr   spsr, r0                @ move     USR mode        CPSR
                      ldmia sp, { r0-r12, sp, lr }^ @ restore  USR mode registers
                      add   sp, sp, #60             @ update   SVC mode SP
+.if STRING_IMPL == 2
+                     vpop  { d0-d7 }               @ restore  USR NEON registers
+.endif
                      movs  pc, lr                  @ return from interrupt
+
+lolevel_handler_fiq: sub   lr, lr, #4              @ correct return address
+                     push  { r0-r3, r12, lr }      @ preserve unbanked caller-saved registers and return address (r12 keeps SP 8-byte aligned)
+
+                     bl    hilevel_handler_fiq     @ invoke high-level C function
+
+                     ldmia sp!, { r0-r3, r12, pc }^ @ restore registers, and return from interrupt
+
+/* On entry, the execution context is at the top of the IRQ or SVC mode
+ * stack (as it was for the high-level handler), so once the return address
+ * is pushed it is at SP + 8.
+ */
+
+lolevel_resched:     push  { r4, lr }              @ preserve return address (r4 keeps SP 8-byte aligned)
+.if MAX_CPUS > 1
+                     mrc   p15, 0, r0, c0, c0, 5   @ read  MPIDR
+                     and   r0, r0, #0x3            @ extract CPU ID
+.else
+                     mov   r0, #0                  @ uniprocessor => CPU ID = 0
+.endif
+                     ldr   r1, =needResched        @ load  address of flags
+                     ldr   r1, [ r1, r0, lsl #2 ]  @ load  flag of this CPU
+                     cmp   r1, #0
+                     addne r0, sp, #8              @ set    high-level C function arg. = execution context
+                     blne  hilevel_handler_resched @ invoke high-level C function iff. flag set
+
+                     pop   { r4, pc }              @ return
+
+/* Invoke fn( x, y ) in SVC mode with IRQ interrupts enabled, i.e., so it
+ * can be interrupted by a nested IRQ, then return to the mode of the caller
+ * with them disabled.  SVC mode is used since an IRQ would overwrite LR and
+ * SPSR of IRQ mode, and SVC handlers execute with IRQ interrupts disabled
+ * so cannot be in progress (other than an enclosing invocation of this).
+ */
+
+lolevel_nest:        push  { r4, lr }              @ preserve return address
+                     mrs   r4, cpsr                @ preserve CPSR, i.e., mode of caller
+                     bic   r3, r4, #0x1F
+                     orr   r3, r3, #0x13
+                     msr   cpsr_c, r3              @ enter SVC mode
+                     push  { r4, lr }              @ preserve SVC mode LR (r4 keeps SP 8-byte aligned)
+
+                     mov   r3, r0                  @ set    function address = fn
+                     mov   r0, r1                  @ set    arg. = x
+                     mov   r1, r2                  @ set    arg. = y
+                     cpsie i                       @  enable IRQ interrupts
+                     blx   r3                      @ invoke function
+                     cpsid i                       @ disable IRQ interrupts
+
+                     pop   { r4, lr }              @ restore SVC mode LR
+                     msr   cpsr_c, r4              @ restore mode of caller
+                     pop   { r4, pc }              @ return
+
+/* Enabling the VFP/NEON unit requires access to co-processors 10 and 11
+ * be granted via CPACR, then the unit itself be enabled via FPEXC.
+ */
+
+lolevel_neon:        mrc   p15, 0, r0, c1, c0, 2   @ read  CPACR
+                     orr   r0, r0, #0x00F00000     @ grant full access to cp10 and cp11
+                     mcr   p15, 0, r0, c1, c0, 2   @ write CPACR
+                     isb
+                     mov   r0, #0x40000000
+                     vmsr  fpexc, r0               @ enable VFP/NEON
+
+                     mov   pc, lr                  @ return
+
+/* A core with no process to execute runs the following idle loop in USR
+ * mode, waiting for an interrupt (i.e., a timer tick or an IPI) each time 
+ * around rather than busy-waiting.
+ */
+
+lolevel_idle:        wfi                           @ wait for interrupt
+                     b     lolevel_idle            @ loop
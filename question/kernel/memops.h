@@ -0,0 +1,36 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __MEMOPS_H
+#define __MEMOPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Optimised variants of memcpy, memset, memmove and strcmp: one of them is
+ * selected at build time to replace the standard implementation (see the
+ * Makefile), but all of them can be invoked explicitly (e.g., to compare
+ * them).
+ */
+
+#if !defined( STRING_IMPL )
+#define STRING_IMPL 0
+#endif
+
+// word-at-a-time variants
+extern void* memcpy_arm ( void* x, const void* y, size_t n );
+extern void* memset_arm ( void* x,       int   c, size_t n );
+extern void* memmove_arm( void* x, const void* y, size_t n );
+extern int   strcmp_arm ( const char* x, const char* y );
+
+// NEON variants
+extern void* memcpy_neon ( void* x, const void* y, size_t n );
+extern void* memset_neon ( void* x,       int   c, size_t n );
+extern void* memmove_neon( void* x, const void* y, size_t n );
+
+#endif
@@ -0,0 +1,233 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* The following functions are optimised versions of memcpy, memset, memmove
+ * and strcmp, which are used by kernel and user code alike (e.g., to copy
+ * execution contexts, stacks and strings).  There are two variants of each:
+ *
+ * - the _arm variants copy or compare a word (or 8 words) at a time if the
+ *   addresses allow, falling back to a byte at a time otherwise, and
+ * - the _neon variants copy or fill 64 bytes at a time via the NEON unit,
+ *   which (unlike ldm/stm) tolerates unaligned addresses, falling back to
+ *   the _arm variants for short or residual lengths; strcmp has no _neon
+ *   variant, since a word at a time already stops at the first 0 byte.
+ *
+ * Which implementation replaces the standard one is selected at build time
+ * (see PROJECT_STRING in the Makefile) via STRING_IMPL: 0 retains newlib,
+ * 1 selects the _arm variants and 2 the _neon variants.  The _neon variants
+ * only use d0...d7, which the low-level handlers preserve iff. they are
+ * selected; otherwise at most one process should use them at a time.
+ */
+
+.fpu neon
+
+.global memcpy_arm
+.global memset_arm
+.global memmove_arm
+.global strcmp_arm
+
+.global memcpy_neon
+.global memset_neon
+.global memmove_neon
+
+.if STRING_IMPL == 1
+.global memcpy
+.global memset
+.global memmove
+.global strcmp
+.set    memcpy,  memcpy_arm
+.set    memset,  memset_arm
+.set    memmove, memmove_arm
+.set    strcmp,  strcmp_arm
+.elseif STRING_IMPL == 2
+.global memcpy
+.global memset
+.global memmove
+.global strcmp
+.set    memcpy,  memcpy_neon
+.set    memset,  memset_neon
+.set    memmove, memmove_neon
+.set    strcmp,  strcmp_arm
+.endif
+
+memcpy_arm:          mov   r12, r0                 @ preserve destination, to return
+                     eor   r3, r0, r1
+                     tst   r3, #3                  @ copy bytes iff. misaligned wrt. each other
+                     bne   memcpy_arm_bytes
+
+memcpy_arm_align:    tst   r0, #3                  @ copy bytes until word-aligned
+                     beq   memcpy_arm_words
+                     subs  r2, r2, #1
+                     blt   memcpy_arm_done
+                     ldrb  r3, [ r1 ], #1
+                     strb  r3, [ r0 ], #1
+                     b     memcpy_arm_align
+
+memcpy_arm_words:    push  { r4-r10 }
+memcpy_arm_8:        subs  r2, r2, #32             @ copy 8 words at a time
+                     ldmhs   r1!, { r3-r10 }
+                     stmhs   r0!, { r3-r10 }
+                     bhs   memcpy_arm_8
+                     add   r2, r2, #32
+                     pop   { r4-r10 }
+
+memcpy_arm_1:        subs  r2, r2, #4              @ copy 1 word  at a time
+                     ldrhs r3, [ r1 ], #4
+                     strhs r3, [ r0 ], #4
+                     bhs   memcpy_arm_1
+                     add   r2, r2, #4
+
+memcpy_arm_bytes:    subs  r2, r2, #1              @ copy 1 byte  at a time
+                     blt   memcpy_arm_done
+                     ldrb  r3, [ r1 ], #1
+                     strb  r3, [ r0 ], #1
+                     b     memcpy_arm_bytes
+
+memcpy_arm_done:     mov   r0, r12                 @ return destination
+                     mov   pc, lr
+
+memset_arm:          mov   r12, r0                 @ preserve destination, to return
+                     and   r1, r1, #0xFF           @ replicate byte into word
+                     orr   r1, r1, r1, lsl #8
+                     orr   r1, r1, r1, lsl #16
+                     mov   r3, r1
+
+memset_arm_align:    tst   r0, #3                  @ fill bytes until word-aligned
+                     beq   memset_arm_4
+                     subs  r2, r2, #1
+                     blt   memset_arm_done
+                     strb  r1, [ r0 ], #1
+                     b     memset_arm_align
+
+memset_arm_4:        subs  r2, r2, #16             @ fill 4 words at a time
+                     stmhs   r0!, { r1, r3 }
+                     stmhs   r0!, { r1, r3 }
+                     bhs   memset_arm_4
+                     add   r2, r2, #16
+
+memset_arm_1:        subs  r2, r2, #4              @ fill 1 word  at a time
+                     strhs r1, [ r0 ], #4
+                     bhs   memset_arm_1
+                     add   r2, r2, #4
+
+memset_arm_bytes:    subs  r2, r2, #1              @ fill 1 byte  at a time
+                     blt   memset_arm_done
+                     strb  r1, [ r0 ], #1
+                     b     memset_arm_bytes
+
+memset_arm_done:     mov   r0, r12                 @ return destination
+                     mov   pc, lr
+
+/* A forward copy is safe unless the destination starts within the source,
+ * i.e., iff. 0 <= dst - src < n (as an unsigned comparison), in which case
+ * a backward copy is used instead.
+ */
+
+memmove_arm:         sub   r3, r0, r1
+                     cmp   r3, r2
+                     bhs   memcpy_arm              @ forward  copy iff. safe
+                     b     memmove_back            @ backward copy otherwise
+
+memmove_neon:        sub   r3, r0, r1
+                     cmp   r3, r2
+                     bhs   memcpy_neon             @ forward  copy iff. safe
+                     b     memmove_back            @ backward copy otherwise
+
+memmove_back:        mov   r12, r0                 @ preserve destination, to return
+                     add   r0, r0, r2              @ start from end of destination
+                     add   r1, r1, r2              @ start from end of source
+                     orr   r3, r0, r1
+                     tst   r3, #3                  @ copy bytes iff. either end misaligned
+                     bne   memmove_back_bytes
+
+memmove_back_1:      subs  r2, r2, #4              @ copy 1 word  at a time
+                     ldrhs r3, [ r1, #-4 ]!
+                     strhs r3, [ r0, #-4 ]!
+                     bhs   memmove_back_1
+                     add   r2, r2, #4
+
+memmove_back_bytes:  subs  r2, r2, #1              @ copy 1 byte  at a time
+                     blt   memmove_back_done
+                     ldrb  r3, [ r1, #-1 ]!
+                     strb  r3, [ r0, #-1 ]!
+                     b     memmove_back_bytes
+
+memmove_back_done:   mov   r0, r12                 @ return destination
+                     mov   pc, lr
+
+/* Comparing a word at a time requires detection of a 0 byte within it:
+ * ( x - 0x01010101 ) & ~x & 0x80808080 is non-zero iff. x has a 0 byte.
+ * Once either a 0 byte or a mismatch is found, the bytes of that word are
+ * compared one at a time to find which (and return their difference).
+ */
+
+strcmp_arm:          orr   r2, r0, r1
+                     tst   r2, #3                  @ compare bytes iff. either misaligned
+                     bne   strcmp_arm_bytes
+
+                     push  { r4, r5 }
+                     ldr   r12, =0x01010101
+
+strcmp_arm_words:    ldr   r2, [ r0 ], #4          @ compare 1 word  at a time
+                     ldr   r3, [ r1 ], #4
+                     sub   r4, r2, r12
+                     bic   r4, r4, r2
+                     tst   r4, r12, lsl #7         @ stop iff. 0 byte
+                     bne   strcmp_arm_found
+                     cmp   r2, r3
+                     beq   strcmp_arm_words        @ stop iff. mismatch
+
+strcmp_arm_found:    sub   r0, r0, #4              @ rewind to start of word
+                     sub   r1, r1, #4
+                     pop   { r4, r5 }
+
+strcmp_arm_bytes:    ldrb  r2, [ r0 ], #1          @ compare 1 byte  at a time
+                     ldrb  r3, [ r1 ], #1
+                     cmp   r2, #1                  @ stop iff. 0 byte (i.e., lo) ...
+                     cmphs r2, r3                  @ ... or mismatch
+                     beq   strcmp_arm_bytes
+
+                     sub   r0, r2, r3              @ return difference
+                     mov   pc, lr
+
+memcpy_neon:         cmp   r2, #64                 @ too short to benefit
+                     blt   memcpy_arm
+
+                     mov   r12, r0                 @ preserve destination, to return
+
+memcpy_neon_64:      vld1.8 { d0-d3 }, [ r1 ]!     @ copy 64 bytes at a time
+                     vld1.8 { d4-d7 }, [ r1 ]!
+                     sub   r2, r2, #64
+                     cmp   r2, #64
+                     vst1.8 { d0-d3 }, [ r0 ]!
+                     vst1.8 { d4-d7 }, [ r0 ]!
+                     bge   memcpy_neon_64
+
+                     push  { r12, lr }             @ copy residual bytes
+                     bl    memcpy_arm
+                     pop   { r0, lr }              @ return destination
+                     mov   pc, lr
+
+memset_neon:         cmp   r2, #64                 @ too short to benefit
+                     blt   memset_arm
+
+                     mov   r12, r0                 @ preserve destination, to return
+                     vdup.8 q0, r1                 @ replicate byte into 32 bytes
+                     vmov  q1, q0
+
+memset_neon_64:      vst1.8 { d0-d3 }, [ r0 ]!     @ fill 64 bytes at a time
+                     vst1.8 { d0-d3 }, [ r0 ]!
+                     sub   r2, r2, #64
+                     cmp   r2, #64
+                     bge   memset_neon_64
+
+                     push  { r12, lr }             @ fill residual bytes
+                     bl    memset_arm
+                     pop   { r0, lr }              @ return destination
+                     mov   pc, lr
+
+.ltorg
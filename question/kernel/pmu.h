@@ -0,0 +1,26 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PMU_H
+#define __PMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The Performance Monitoring Unit (PMU) of a Cortex-A8 or Cortex-A9 core
+ * includes a cycle counter (PMCCNTR) plus several event counters, all of
+ * which are accessed via co-processor 15.  Each core has its own PMU, so
+ * pmu_init should be invoked on every core.
+ */
+
+// enable the cycle counter (reset to 0), and allow user mode to read it
+extern void     pmu_init();
+// read the cycle counter
+extern uint32_t pmu_cycles();
+
+#endif
@@ -0,0 +1,30 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* The following functions configure and read the PMU cycle counter: PMCR
+ * enables the counters and resets the cycle counter, PMCNTENSET bit 31
+ * enables the cycle counter specifically, and PMUSERENR bit 0 allows user
+ * mode to read it (e.g., for benchmarking).
+ */
+
+.global pmu_init
+.global pmu_cycles
+
+pmu_init:            mrc   p15, 0, r0, c9, c12, 0  @ read  PMCR
+                     orr   r0, r0, #0x5            @ set   E (enable counters) and C (reset cycle counter)
+                     mcr   p15, 0, r0, c9, c12, 0  @ write PMCR
+                     mov   r0, #0x80000000
+                     mcr   p15, 0, r0, c9, c12, 1  @ write PMCNTENSET: enable cycle counter
+                     mov   r0, #0x1
+                     mcr   p15, 0, r0, c9, c14, 0  @ write PMUSERENR:  enable user mode access
+                     isb
+
+                     mov   pc, lr                  @ return
+
+pmu_cycles:          mrc   p15, 0, r0, c9, c13, 0  @ read  PMCCNTR
+
+                     mov   pc, lr                  @ return
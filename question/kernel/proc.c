@@ -0,0 +1,1393 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "proc.h"
+
+/* Process management, i.e., the process table, run queues and scheduler,
+ * futex wait queues, pipes and file descriptor tables, plus the bookkeeping
+ * of fork.  The platform is only accessed via hal.h, so this can be built
+ * natively on a host (see host/) as well as for the target.
+ */
+
+int currentProcesses = 0;
+uint32_t time = 0;
+
+pcb_t procTab[MAX_PROCS];
+fd_t openFileTab[MAX_FDS];
+
+int futexQueue[FUTEX_BUCKETS]; // PID at head of each futex wait queue, -1 if empty
+
+cpu_t cpus[MAX_CPUS];
+
+group_t groups[MAX_GROUPS];
+
+spinlock_t procLock = 0;
+spinlock_t fileLock = 0;
+spinlock_t groupLock = 0;
+
+volatile uint32_t needResched[MAX_CPUS]; // a word per CPU, so lolevel.s can index it by CPU ID
+
+// Print an n character string to the terminal
+void print(char *x, int n)
+{
+  hal_print(x, n);
+}
+
+// Context switch from the previous to the next process, recording it in the trace
+void dispatch(ctx_t *ctx, pcb_t *prev, pcb_t *next)
+{
+  if (NULL != prev)
+    memcpy(&prev->ctx, ctx, sizeof(ctx_t)); // preserve execution context of P_{prev}
+  if (NULL != next)
+    memcpy(ctx, &next->ctx, sizeof(ctx_t)); // restore execution context of P_{next}
+
+  trace(TRACE_SWITCH, (NULL != prev) ? prev->pid : -1, (NULL != next) ? next->pid : -1, 0);
+
+  executing = next; // update executing process to P_{next}
+
+  return;
+}
+
+/* Each process has a weight per its niceness, so that each step in niceness
+ * changes its share of a CPU by ~1.25x, with a niceness of 0 having weight
+ * 1024.  As it executes, its virtual runtime advances at a rate of 1024 /
+ * weight, so the process with the least has received less than its share;
+ * this table holds 2^32 / weight, for niceness NICE_MIN...NICE_MAX, so the
+ * advance is a multiply and shift.
+ */
+const uint32_t schedInvWeight[NICE_MAX - NICE_MIN + 1] = {
+      59856,      76039,      92817,     118348,     147320,     184698,     229616,     287308,
+     360437,     449829,     563644,     704092,     875808,    1099582,    1376151,    1717299,
+    2157191,    2708049,    3363325,    4194304,    5237764,    6557201,    8165337,   10153586,
+   12820797,   15790320,   19976592,   24970740,   31350126,   39045157,   49367440,   61356675,
+   76695844,   95443717,  119304647,  148102320,  186737708,  238609294,  286331153,  357913941
+};
+
+/* Charge t cycles of CPU time to the group of process p: once that uses up
+ * the group's quota for the current period, the group is throttled, so its
+ * processes are parked (rather than selected) by the scheduler until the
+ * period ends.
+ */
+void group_charge(pcb_t *p, uint32_t t)
+{
+  group_t *g = &groups[p->group];
+
+  spin_lock(&groupLock);
+
+  g->used += t;
+  g->usedTotal += t;
+
+  if (g->quota > 0 && g->used >= g->quota && !g->throttled)
+  {
+    g->throttled = true;
+    g->throttles++;
+  }
+
+  spin_unlock(&groupLock);
+}
+
+// Whether the group of process p has used up its quota for the current period
+bool group_throttled(pcb_t *p)
+{
+  return groups[p->group].throttled;
+}
+
+// Park a ready process (not in any run queue) on the list of its throttled group
+void group_park(pcb_t *p)
+{
+  spin_lock(&groupLock);
+
+  int *link = &groups[p->group].parked;
+
+  while (*link >= 0)
+    link = &procTab[*link].groupNext;
+
+  p->groupNext = -1;
+  *link = p->pid;
+
+  spin_unlock(&groupLock);
+}
+
+// Remove process p from the list of processes parked by its group, returning true iff. it was in it
+bool group_remove(pcb_t *p)
+{
+  bool found = false;
+
+  spin_lock(&groupLock);
+
+  int *link = &groups[p->group].parked;
+
+  while (*link >= 0)
+  {
+    if (*link == p->pid)
+    {
+      *link = p->groupNext;
+      found = true;
+      break;
+    }
+    link = &procTab[*link].groupNext;
+  }
+
+  spin_unlock(&groupLock);
+
+  p->groupNext = -1;
+
+  return found;
+}
+
+/* Start a new period for a group, on expiry of its timer: its usage is reset
+ * and its parked processes are made ready again.  The timer is re-armed iff.
+ * the group still has a quota; the caller must hold procLock.
+ */
+void group_refill(ktimer_t *x)
+{
+  group_t *g = (group_t *)((uint8_t *)x - offsetof(group_t, timer));
+
+  spin_lock(&groupLock);
+  int pid = g->parked;
+  g->parked = -1;
+  g->used = 0;
+  g->throttled = false;
+  spin_unlock(&groupLock);
+
+  if (g->quota > 0)
+    timer_arm(&g->timer, TIMER_MS_TO_TICKS(g->period));
+
+  while (pid >= 0)
+  {
+    pcb_t *p = &procTab[pid];
+
+    pid = p->groupNext;
+    p->groupNext = -1;
+    if (p->status == STATUS_READY)
+      make_ready(p, &cpus[p->cpu]);
+  }
+}
+
+// Move process p into group gid, making it ready iff. it was parked by its previous group; the caller must hold procLock
+void group_move(pcb_t *p, int gid)
+{
+  bool parked = group_remove(p);
+
+  p->group = gid;
+
+  if (parked && p->status == STATUS_READY)
+    make_ready(p, &cpus[p->cpu]);
+}
+
+// Limit group gid to quota cycles of CPU time per period ms, or remove its limit iff. quota = 0, starting a new period; the caller must hold procLock
+void group_limit(int gid, uint32_t quota, uint32_t period)
+{
+  group_t *g = &groups[gid];
+
+  spin_lock(&groupLock);
+  g->quota = quota;
+  g->period = period;
+  spin_unlock(&groupLock);
+
+  group_refill(&g->timer);
+
+  if (quota == 0)
+    timer_cancel(&g->timer);
+
+  wheel_update();
+}
+
+/* Preempt any executing process whose group has used up its quota, counting
+ * the time since that CPU last charged it, so a quota is enforced to within
+ * a timer wheel tick (rather than a scheduler tick).  The wheel runs while
+ * any group has a quota, since its timer is then armed; the caller must
+ * hold procLock.
+ */
+void group_enforce()
+{
+  uint32_t now = hal_counter();
+
+  for (int i = 0; i < MAX_CPUS; i++)
+  {
+    cpu_t *cpu = &cpus[i];
+    pcb_t *p = cpu->current;
+
+    if (!cpu->online || p == &cpu->idle || groups[p->group].quota == 0)
+      continue;
+
+    if (groups[p->group].throttled || groups[p->group].used + (now - cpu->execStamp) >= groups[p->group].quota)
+    {
+      if (i == cpu_id())
+        needResched[i] = 1;
+      else
+        cpu_kick(i);
+    }
+  }
+}
+
+/* Charge the time since the last charge on this CPU to process p: a normal
+ * process accrues virtual runtime, whereas a SCHED_RR process uses up its
+ * slice, and either is charged to its group (the idle process is not
+ * charged).
+ */
+void sched_charge(cpu_t *cpu, pcb_t *p)
+{
+  uint32_t now = hal_counter();
+  uint32_t t = now - cpu->execStamp;
+  int nice = (int)p->niceness;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  if (p == &cpu->idle)
+    ;
+  else if (p->policy == SCHED_NORMAL)
+    p->vruntime += ((uint64_t)t * schedInvWeight[nice - NICE_MIN]) >> 22; // t * 2^10 / weight
+  else if (p->policy == SCHED_RR)
+    p->rrUsed += t;
+
+  if (p != &cpu->idle)
+    group_charge(p, t);
+
+  cpu->execStamp = now;
+}
+
+/* Order processes for the run queue: real-time before normal processes,
+ * then real-time processes by priority and order of queueing, and normal
+ * processes by virtual runtime, then PID, so the order is total.
+ */
+bool rq_before(int a, int b)
+{
+  pcb_t *p = &procTab[a];
+  pcb_t *q = &procTab[b];
+
+  if (p->rtPriority != q->rtPriority)
+    return p->rtPriority > q->rtPriority;
+  if (p->rtPriority > 0 && p->rqSeq != q->rqSeq)
+    return (int32_t)(p->rqSeq - q->rqSeq) < 0;
+  if (p->rtPriority == 0 && p->vruntime != q->vruntime)
+    return p->vruntime < q->vruntime;
+
+  return a < b;
+}
+
+// Place PID x at index i of a CPU's run queue heap
+void rq_set(cpu_t *cpu, int i, int x)
+{
+  cpu->ready[i] = x;
+  procTab[x].rqIndex = i;
+}
+
+// Restore the heap property from index i, moving the entry toward the root and then the leaves
+void rq_sift(cpu_t *cpu, int i)
+{
+  int x = cpu->ready[i];
+
+  while (i > 0 && rq_before(x, cpu->ready[(i - 1) / 2]))
+  {
+    rq_set(cpu, i, cpu->ready[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+
+  while (2 * i + 1 < cpu->readyNum)
+  {
+    int c = 2 * i + 1;
+
+    if (c + 1 < cpu->readyNum && rq_before(cpu->ready[c + 1], cpu->ready[c]))
+      c++;
+    if (!rq_before(cpu->ready[c], x))
+      break;
+
+    rq_set(cpu, i, cpu->ready[c]);
+    i = c;
+  }
+
+  rq_set(cpu, i, x);
+}
+
+// Insert a ready process into a CPU's run queue
+void rq_insert(cpu_t *cpu, pcb_t *p)
+{
+  p->cpu = cpu->id;
+
+  rq_set(cpu, cpu->readyNum++, p->pid);
+  rq_sift(cpu, p->rqIndex);
+}
+
+// Remove a process from a CPU's run queue
+void rq_remove(cpu_t *cpu, pcb_t *p)
+{
+  int i = p->rqIndex;
+
+  if (i >= 0 && i < cpu->readyNum && cpu->ready[i] == p->pid)
+  {
+    cpu->readyNum--;
+
+    if (i < cpu->readyNum)
+    {
+      rq_set(cpu, i, cpu->ready[cpu->readyNum]);
+      rq_sift(cpu, i);
+    }
+  }
+
+  p->rqIndex = -1;
+}
+
+// The ready process with the least virtual runtime on a CPU, or NULL if none
+pcb_t *rq_first(cpu_t *cpu)
+{
+  return (cpu->readyNum > 0) ? &procTab[cpu->ready[0]] : NULL;
+}
+
+// Advance a CPU's minimum virtual runtime, per the (normal) process executing or first ready
+void rq_update_min(cpu_t *cpu)
+{
+  pcb_t *first = rq_first(cpu);
+  pcb_t *current = (cpu->current != &cpu->idle) ? cpu->current : NULL;
+
+  if (first != NULL && first->policy != SCHED_NORMAL)
+    first = NULL;
+  if (current != NULL && current->policy != SCHED_NORMAL)
+    current = NULL;
+  uint64_t x;
+
+  if (current == NULL && first == NULL)
+    return;
+  else if (current == NULL)
+    x = first->vruntime;
+  else if (first == NULL || current->vruntime < first->vruntime)
+    x = current->vruntime;
+  else
+    x = first->vruntime;
+
+  if (x > cpu->minVruntime)
+    cpu->minVruntime = x;
+}
+
+// Ask another CPU to invoke the scheduler, e.g., since its run queue changed
+void cpu_kick(int id)
+{
+  if (id != cpu_id() && cpus[id].online)
+    hal_kick(id);
+}
+
+// Select the CPU with the least work (executing plus ready processes)
+cpu_t *cpu_least_loaded()
+{
+  cpu_t *best = &cpus[cpu_id()];
+  int bestLoad = INT32_MAX;
+
+  for (int i = 0; i < MAX_CPUS; i++)
+  {
+    cpu_t *cpu = &cpus[i];
+    int load = cpu->readyNum + (cpu->current != &cpu->idle);
+
+    if (cpu->online && load < bestLoad)
+    {
+      bestLoad = load;
+      best = cpu;
+    }
+  }
+
+  return best;
+}
+
+// Lock the run queue of the CPU holding a process, allowing for it migrating
+cpu_t *rq_lock(pcb_t *p)
+{
+  while (1)
+  {
+    cpu_t *cpu = &cpus[p->cpu];
+
+    spin_lock(&cpu->lock);
+    if (p->cpu == cpu->id)
+      return cpu;
+    spin_unlock(&cpu->lock);
+  }
+}
+
+/* Make a process ready, queueing it on a CPU and prompting that CPU to run
+ * it.  Its virtual runtime is raised to at least the CPU's minimum, less a
+ * credit of SCHED_WAKE_CREDIT iff. it has executed before (i.e., it woke
+ * up, rather than was forked), so a process which slept long is favoured,
+ * but only briefly, rather than until it catches up.  A real-time process
+ * queues behind others of equal priority.
+ *
+ * The process preempts the executing one iff. the CPU is idle, it is a
+ * real-time process of higher priority, or both are normal processes and
+ * it has less virtual runtime by at least SCHED_WAKE_GRAN (so processes
+ * which wake each other in turn do not switch for a trivial difference).
+ * If so this CPU reschedules on return from the current handler, and any
+ * other CPU is kicked.
+ */
+void make_ready(pcb_t *p, cpu_t *cpu)
+{
+  spin_lock(&cpu->lock);
+
+  uint64_t credit = (p->lastCpu >= 0) ? SCHED_WAKE_CREDIT : 0;
+  uint64_t least = (cpu->minVruntime > credit) ? cpu->minVruntime - credit : 0;
+
+  if (p->vruntime < least)
+    p->vruntime = least;
+
+  p->status = STATUS_READY;
+  p->rqSeq = cpu->rqSeq++;
+  p->wakeStamp = hal_counter();
+  p->woken = true;
+  rq_insert(cpu, p);
+
+  pcb_t *current = cpu->current;
+  bool preempt;
+
+  if (current == &cpu->idle)
+    preempt = true;
+  else if (p->rtPriority > 0 || current->rtPriority > 0)
+    preempt = rq_before(p->pid, current->pid);
+  else
+  {
+    sched_charge(cpu, current); // bring its virtual runtime up to date
+    preempt = p->vruntime + SCHED_WAKE_GRAN < current->vruntime;
+  }
+
+  if (preempt && cpu->id == cpu_id())
+    needResched[cpu->id] = 1;
+
+  spin_unlock(&cpu->lock);
+
+  if (preempt)
+    cpu_kick(cpu->id);
+}
+
+// Number of processes a CPU is executing or has ready
+int cpu_load(cpu_t *cpu)
+{
+  return cpu->readyNum + (cpu->current != &cpu->idle);
+}
+
+/* Select a process to migrate from one CPU's run queue to another, or NULL
+ * if there is none: a process which last executed on the destination CPU
+ * is preferred, otherwise the one which has waited longest.  If coldOnly
+ * is set, processes which executed recently (so whose working set may still
+ * be cached by the source CPU) are not considered.
+ */
+pcb_t *rq_migrant(cpu_t *from, cpu_t *to, bool coldOnly)
+{
+  pcb_t *best = NULL;
+
+  for (int i = 0; i < from->readyNum; i++)
+  {
+    pcb_t *p = &procTab[from->ready[i]];
+    bool cold = p->lastCpu < 0 || (time - p->lastExec) >= CACHE_HOT_TIME;
+
+    if (coldOnly && !cold && p->lastCpu != to->id)
+      continue;
+    if (p->lastCpu == to->id)
+      return p;
+    if (best == NULL || p->lastExec < best->lastExec)
+      best = p;
+  }
+
+  return best;
+}
+
+/* Move a ready process between run queues, preserving its virtual runtime
+ * relative to the CPU's minimum (since each CPU's advances independently),
+ * and queueing it behind real-time processes of equal priority; the caller
+ * must hold both locks.
+ */
+void rq_migrate(cpu_t *from, cpu_t *to, pcb_t *p)
+{
+  rq_remove(from, p);
+
+  p->rqSeq = to->rqSeq++;
+
+  if (p->vruntime >= from->minVruntime)
+    p->vruntime = to->minVruntime + (p->vruntime - from->minVruntime);
+  else if (to->minVruntime > from->minVruntime - p->vruntime)
+    p->vruntime = to->minVruntime - (from->minVruntime - p->vruntime);
+  else
+    p->vruntime = 0;
+
+  rq_insert(to, p);
+}
+
+/* Steal a ready process from the busiest other CPU into an (idle) CPU's run
+ * queue, returning true on success.  The caller holds the idle CPU's lock,
+ * so the victim's lock is only tried: if it is held, that CPU is busy in
+ * the scheduler anyway, and waiting could deadlock.
+ */
+bool rq_steal(cpu_t *cpu)
+{
+  cpu_t *victim = NULL;
+
+  for (int i = 0; i < MAX_CPUS; i++)
+  {
+    if (i != cpu->id && cpus[i].online && cpus[i].readyNum > 0)
+    {
+      if (victim == NULL || cpus[i].readyNum > victim->readyNum)
+        victim = &cpus[i];
+    }
+  }
+
+  if (victim == NULL || !spin_trylock(&victim->lock))
+    return false;
+
+  pcb_t *p = rq_migrant(victim, cpu, false);
+  if (p != NULL)
+    rq_migrate(victim, cpu, p);
+
+  spin_unlock(&victim->lock);
+
+  return p != NULL;
+}
+
+/* Rebalance load by migrating one (cache cold) process from the busiest to
+ * the least busy CPU, iff. their loads differ by at least 2; invoked every
+ * BALANCE_PERIOD timer ticks.
+ */
+void rq_balance()
+{
+  cpu_t *busiest = NULL;
+  cpu_t *idlest = NULL;
+
+  for (int i = 0; i < MAX_CPUS; i++)
+  {
+    cpu_t *cpu = &cpus[i];
+
+    if (!cpu->online)
+      continue;
+    if (busiest == NULL || cpu_load(cpu) > cpu_load(busiest))
+      busiest = cpu;
+    if (idlest == NULL || cpu_load(cpu) < cpu_load(idlest))
+      idlest = cpu;
+  }
+
+  if (busiest == NULL || idlest == NULL || cpu_load(busiest) - cpu_load(idlest) < 2)
+    return;
+
+  cpu_t *first = busiest->id < idlest->id ? busiest : idlest;
+  cpu_t *second = busiest->id < idlest->id ? idlest : busiest;
+
+  spin_lock(&first->lock);
+  spin_lock(&second->lock);
+
+  pcb_t *p = rq_migrant(busiest, idlest, true);
+  if (p != NULL)
+    rq_migrate(busiest, idlest, p);
+
+  spin_unlock(&second->lock);
+  spin_unlock(&first->lock);
+
+  if (p != NULL)
+    cpu_kick(idlest->id);
+}
+
+/* Scheduling algorithm
+*  real-time processes (i.e., SCHED_FIFO or SCHED_RR) take strict priority
+*  over normal processes, which share the CPU by a weighted fair algorithm.
+*  The executing process is charged for the time since it was last charged,
+*  then the next process is selected from this CPU's run queue as follows:
+*
+*  - If the executing process blocked, terminated or is idle, the first
+*    ready process.
+*  - If it is normal and yielded, the first ready process, even if that
+*    has more virtual runtime than itself.
+*  - Otherwise, it keeps executing unless the first ready process precedes
+*    it: a real-time process which yields, or is SCHED_RR and has used its
+*    slice, is first queued behind those of equal priority.
+*
+*  The first ready process is the real-time process of highest priority
+*  which was queued first, or otherwise the normal process with the least
+*  virtual runtime.  A process whose group has used up its quota is not
+*  selected, but parked until the group's next period.  So, under load,
+*  each normal process receives a share of the CPU proportional to its
+*  weight, and a pick costs O(log n) for n ready processes.  If no process
+*  is eligible, the CPU tries to steal one from another CPU and otherwise
+*  runs its idle process.
+*/
+void schedule(ctx_t *ctx)
+{
+  cpu_t *cpu = &cpus[cpu_id()];
+
+  spin_lock(&cpu->lock);
+
+  pcb_t *prev = cpu->current;
+  pcb_t *next = prev; // default next = currently executing
+
+  sched_charge(cpu, prev);
+  needResched[cpu->id] = 0;
+
+  bool park = (prev != &cpu->idle && prev->status == STATUS_EXECUTING && group_throttled(prev));
+
+  if (prev == &cpu->idle || prev->status != STATUS_EXECUTING || park)
+  {
+    next = &cpu->idle; // blocked, terminated, throttled or idle, so any ready process is preferable
+
+    if (cpu->readyNum == 0)
+      rq_steal(cpu);
+  }
+  else if (prev->policy != SCHED_NORMAL && (prev->yielding || (prev->policy == SCHED_RR && prev->rrUsed >= SCHED_RR_SLICE)))
+  {
+    prev->rrUsed = 0;
+    prev->rqSeq = cpu->rqSeq++; // queue behind those of equal priority
+  }
+
+  pcb_t *first = rq_first(cpu);
+
+  while (first != NULL && group_throttled(first)) // park processes whose group is throttled
+  {
+    rq_remove(cpu, first);
+    group_park(first);
+    first = rq_first(cpu);
+  }
+
+  if (first != NULL && (next == &cpu->idle || (prev->yielding && prev->policy == SCHED_NORMAL) || rq_before(first->pid, prev->pid)))
+    next = first;
+
+  if (next != prev && next != &cpu->idle)
+    rq_remove(cpu, next);
+
+  dispatch(ctx, prev, next); // context switch previous -> next
+
+  if (prev != next) // blocked, yielded or terminated, vs. preempted
+  {
+    if (prev->status != STATUS_EXECUTING || prev->yielding)
+      prev->stats.nvcsw++;
+    else
+      prev->stats.nivcsw++;
+  }
+  prev->yielding = false;
+
+  if (prev != &cpu->idle)
+  {
+    prev->lastExec = time;
+    if (prev->status == STATUS_EXECUTING && prev != next)
+    {
+      prev->status = STATUS_READY; // update execution status of previous process
+      if (park)
+        group_park(prev);
+      else
+        rq_insert(cpu, prev);
+    }
+  }
+  next->status = STATUS_EXECUTING; // update execution status of next process
+  if (next != &cpu->idle)
+    next->lastCpu = cpu->id;
+
+  if (next->woken) // record latency from being made ready
+  {
+    uint32_t t = hal_counter() - next->wakeStamp;
+
+    next->woken = false;
+    next->stats.wakeCycles += t;
+    next->stats.wakeNum++;
+    if (t > next->stats.wakeMax)
+      next->stats.wakeMax = t;
+  }
+
+  rq_update_min(cpu);
+
+  time++;
+
+  spin_unlock(&cpu->lock);
+
+  if (next == &cpu->idle) // nothing else to do, so drain some of the trace
+    trace_drain(TRACE_BUDGET, false);
+
+  return;
+}
+
+/* Set the scheduling class and real-time priority of a process, which must
+ * be 0 for SCHED_NORMAL and 1...SCHED_RT_MAX otherwise.  A ready process
+ * is re-queued per its new priority; a process which becomes normal starts
+ * at its CPU's minimum virtual runtime.  Either way its CPU reschedules,
+ * since the process may now preempt, or be preempted by, another.
+ */
+int sched_set(pcb_t *p, int policy, int priority)
+{
+  bool valid = (policy == SCHED_NORMAL) ? (priority == 0) : ((policy == SCHED_FIFO || policy == SCHED_RR) && priority >= 1 && priority <= SCHED_RT_MAX);
+
+  if (!valid)
+    return -1;
+
+  cpu_t *cpu = rq_lock(p);
+  bool ready = (p->status == STATUS_READY && p->rqIndex >= 0);
+
+  if (ready)
+    rq_remove(cpu, p);
+
+  if (policy == SCHED_NORMAL && p->policy != SCHED_NORMAL)
+    p->vruntime = cpu->minVruntime;
+
+  p->policy = policy;
+  p->rtPriority = priority;
+  p->rrUsed = 0;
+  p->rqSeq = cpu->rqSeq++;
+
+  if (ready)
+    rq_insert(cpu, p);
+
+  if (cpu->id == cpu_id())
+    needResched[cpu->id] = 1;
+
+  spin_unlock(&cpu->lock);
+
+  cpu_kick(cpu->id);
+
+  return 0;
+}
+
+// Allocate memory and fd to file
+int open_fd(pipe_t *p, int flag)
+{
+  int fd = -1;
+
+  spin_lock(&fileLock);
+
+  for (int i = 3; i < MAX_FDS; i++)
+  {
+    if (openFileTab[i].refCount == 0) // file not open
+    {
+      fd = i;
+
+      // add pipe to open file table
+      openFileTab[fd].file = p;
+      openFileTab[fd].flag = flag;
+      openFileTab[fd].refCount++;
+      if (flag == RDONLY)
+        p->readers++;
+      else
+        p->writers++;
+
+      // add pipe to process' fd table
+      for (int j = 0; j < MAX_FDS; j++)
+      {
+        if (executing->fdTab[j] < 0) // table entry unused
+        { 
+          executing->fdTab[j] = fd;
+          break;
+        }
+      }
+
+      break;
+    }
+  }
+
+  spin_unlock(&fileLock);
+
+  return fd;
+}
+
+// Make file descriptor and, if no longer needed, file's allocated memory available
+int close_fd(int fd, pid_t pid)
+{
+  int r = -1; // fd index out of bounds
+
+  if (fd >= 0 && fd < MAX_FDS)
+  {
+    spin_lock(&fileLock);
+
+    // wipe the process' corresponding file descriptor
+    for (int i = 0; i < MAX_FDS; i++)
+    {
+      if (procTab[pid].fdTab[i] == fd)
+        procTab[pid].fdTab[i] = -1;
+    }
+
+    // update file reference count
+    openFileTab[fd].refCount--;
+
+    pipe_t *file = openFileTab[fd].file;
+    bool closed = (openFileTab[fd].refCount <= 0 && file != NULL); // this end of a pipe is no longer open
+    bool wake = false;
+
+    // free file data if no descriptors for it remain, i.e., neither end of a pipe is open
+    if (closed)
+    {
+      if (openFileTab[fd].flag == RDONLY)
+        file->readers--;
+      else
+        file->writers--;
+
+      openFileTab[fd].file = NULL;
+
+      wake = !waitq_empty(&file->pollq);
+      if (wake) // pin it, so pipe_wake frees it (iff. unused) rather than another CPU closing the other end
+        file->pins++;
+      else if (pipe_unused(file))
+        free(file);
+    }
+
+    spin_unlock(&fileLock);
+
+    if (wake) // processes polling the other end see it closed, or (iff. freeing it) leave its wait queue
+      pipe_wake(file);
+
+    r = 0; // success
+
+  }
+
+  return r;
+}
+
+// Allocate an empty pipe, with neither end open (so the first close_fd of an end opened via open_fd frees it once unused)
+pipe_t *pipe_alloc()
+{
+  spin_lock(&fileLock);
+  pipe_t *p = malloc(sizeof(pipe_t));
+  spin_unlock(&fileLock);
+
+  p->front = 0;
+  p->rear = -1;
+  p->size = sizeof(p->buffer);
+  p->full = false;
+  p->waiting = 0;
+  p->readers = 0;
+  p->writers = 0;
+  memset(&p->pollq, 0, sizeof(waitq_t));
+  p->pins = 0;
+
+  return p;
+}
+
+// Read up to n bytes from a pipe into x, returning the number read; the caller must hold fileLock
+int pipe_read(pipe_t *pipe, char *x, int n)
+{
+  // the pipe's buffer is implemented as a circular queue
+  int i = 0;
+  for (; i < n; i++)
+  {
+    int front = pipe->front;
+
+    if ((front == (pipe->rear + 1) % pipe->size) && !pipe->full) // check queue empty
+      break;
+    *(x + i) = pipe->buffer[front];
+    pipe->front = (front + 1) % pipe->size;
+    if (pipe->full)
+      pipe->full = false;
+  }
+
+  return i;
+}
+
+// Write up to n bytes from x into a pipe, returning the number written; the caller must hold fileLock
+int pipe_write(pipe_t *pipe, char *x, int n)
+{
+  // the pipe's buffer is implemented as a circular queue
+  int i = 0;
+  for (; i < n; i++)
+  {
+    if (pipe->full)
+      break;
+    pipe->rear = (pipe->rear + 1) % pipe->size;
+    pipe->buffer[pipe->rear] = *x;
+    x++;
+    if (pipe->front == (pipe->rear + 1) % pipe->size) // check if queue full
+    {
+      pipe->full = true;
+    }
+  }
+
+  return i;
+}
+
+// Select the futex wait queue for an address
+int futex_bucket(uintptr_t addr)
+{
+  return (addr >> 2) % FUTEX_BUCKETS;
+}
+
+// Append a process to the tail of the wait queue for addr
+void futex_enqueue(pcb_t *p, uintptr_t addr)
+{
+  int *link = &futexQueue[futex_bucket(addr)];
+
+  while (*link >= 0)
+    link = &procTab[*link].waitNext;
+
+  p->futexAddr = addr;
+  p->waitNext = -1;
+  *link = p->pid;
+}
+
+// Remove a (waiting) process from whichever wait queue it is in
+void futex_dequeue(pcb_t *p)
+{
+  int *link = &futexQueue[futex_bucket(p->futexAddr)];
+
+  while (*link >= 0)
+  {
+    if (*link == p->pid)
+    {
+      *link = p->waitNext;
+      break;
+    }
+    link = &procTab[*link].waitNext;
+  }
+
+  p->waitNext = -1;
+}
+
+// Wake up to n processes waiting on addr, returning the number woken
+int futex_wake(uintptr_t addr, int n)
+{
+  int woken = 0;
+  int *link = &futexQueue[futex_bucket(addr)];
+
+  while (*link >= 0 && woken < n)
+  {
+    pcb_t *p = &procTab[*link];
+
+    if (p->futexAddr == addr && p->waitPipe == NULL) // other addresses may share the bucket
+    {
+      *link = p->waitNext;
+      p->waitNext = -1;
+      timer_cancel(&p->timer);
+      p->ctx.gpr[0] = 0;            // return value = woken
+      make_ready(p, &cpus[p->cpu]); // prefer the CPU it last executed on
+      woken++;
+    }
+    else
+      link = &p->waitNext;
+  }
+
+  return woken;
+}
+
+/* Complete the blocked reads of processes waiting on a pipe, in the order
+ * they blocked, for as long as it holds data.  Each read is performed on
+ * behalf of the waiting process, using the buffer and length in its saved
+ * registers, so it returns from read_timed with the result in place.
+ *
+ * Then, since the pipe has changed, wake each process polling it if any of
+ * its fds is now ready: the poll is likewise completed on its behalf, so it
+ * returns from poll with the revents and result in place.
+ *
+ * The caller pins the pipe while still holding fileLock, since once it is
+ * released another CPU may close the pipe: whichever of close_fd and the
+ * last pending pipe_wake finds it unused frees it.
+ */
+void pipe_wake(pipe_t *pipe)
+{
+  spin_lock(&procLock);
+
+  int *link = &futexQueue[futex_bucket((uintptr_t)pipe)];
+
+  while (*link >= 0)
+  {
+    pcb_t *p = &procTab[*link];
+
+    if (p->waitPipe == pipe)
+    {
+      spin_lock(&fileLock);
+      int r = pipe_read(pipe, (char *)p->ctx.gpr[1], (int)p->ctx.gpr[2]);
+      if (r > 0)
+        pipe->waiting--;
+      spin_unlock(&fileLock);
+
+      if (r == 0) // pipe drained
+        break;
+
+      *link = p->waitNext;
+      p->waitNext = -1;
+      p->waitPipe = NULL;
+      timer_cancel(&p->timer);
+      p->ctx.gpr[0] = r;            // return value = bytes read
+      make_ready(p, &cpus[p->cpu]); // prefer the CPU it last executed on
+    }
+    else
+      link = &p->waitNext;
+  }
+
+  waitq_t woken;
+  memset(&woken, 0, sizeof(waitq_t));
+
+  spin_lock(&fileLock);
+
+  for (int i = 0; i < MAX_PROCS; i++)
+  {
+    if (pipe->pollq.pids[i / 32] & (1u << (i % 32)))
+    {
+      pcb_t *p = &procTab[i];
+      int r = poll_scan(p->pollFds, p->pollNfds);
+
+      if (r > 0)
+      {
+        poll_dequeue(p);
+        p->ctx.gpr[0] = r; // return value = number of fds ready
+        woken.pids[i / 32] |= 1u << (i % 32);
+      }
+    }
+  }
+
+  pipe->pins--;
+  if (pipe_unused(pipe)) // closed while pinned
+    free(pipe);
+
+  spin_unlock(&fileLock);
+
+  for (int i = 0; i < MAX_PROCS; i++)
+  {
+    if (woken.pids[i / 32] & (1u << (i % 32)))
+    {
+      pcb_t *p = &procTab[i];
+      timer_cancel(&p->timer);
+      make_ready(p, &cpus[p->cpu]); // prefer the CPU it last executed on
+    }
+  }
+
+  spin_unlock(&procLock);
+}
+
+// Test whether a pipe can be freed, i.e., neither end is open and no pipe_wake is pending; the caller must hold fileLock
+bool pipe_unused(pipe_t *pipe)
+{
+  return pipe->readers <= 0 && pipe->writers <= 0 && pipe->pins <= 0;
+}
+
+// Test whether no process is in a wait queue; the caller must hold procLock or fileLock
+bool waitq_empty(waitq_t *q)
+{
+  for (int i = 0; i < (MAX_PROCS + 31) / 32; i++)
+  {
+    if (q->pids[i] != 0)
+      return false;
+  }
+
+  return true;
+}
+
+// Set the events which occurred in each polled fd, returning the number with any; the caller must hold fileLock
+int poll_scan(pollfd_t *fds, int n)
+{
+  int r = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    int fd = fds[i].fd;
+    int16_t events = 0;
+
+    if (fd < 0) // ignored
+      events = 0;
+    else if (fd == 0) // stdin, which never has data
+      events = 0;
+    else if (fd == 1 || fd == 2) // stdout or stderr, which are always writable
+      events = POLLOUT;
+    else if (fd >= MAX_FDS || openFileTab[fd].refCount <= 0 || openFileTab[fd].file == NULL)
+      events = POLLNVAL;
+    else if (openFileTab[fd].flag == RDONLY) // read end of pipe
+    {
+      pipe_t *pipe = openFileTab[fd].file;
+      if (pipe->full || pipe->front != (pipe->rear + 1) % pipe->size)
+        events |= POLLIN;
+      if (pipe->writers <= 0)
+        events |= POLLHUP;
+    }
+    else // write end of pipe
+    {
+      pipe_t *pipe = openFileTab[fd].file;
+      if (!pipe->full)
+        events |= POLLOUT;
+      if (pipe->readers <= 0)
+        events |= POLLERR;
+    }
+
+    fds[i].revents = events & (fds[i].events | POLLERR | POLLHUP | POLLNVAL); // the latter are reported regardless
+    if (fds[i].revents != 0)
+      r++;
+  }
+
+  return r;
+}
+
+// Add the executing process, about to block in poll, to the wait queue of each pipe it polls; the caller must hold procLock and fileLock
+void poll_enqueue(pollfd_t *fds, int n)
+{
+  pcb_t *self = executing;
+  int k = 0;
+
+  for (int i = 0; i < n && k < POLL_MAX; i++)
+  {
+    int fd = fds[i].fd;
+
+    if (fd < 3 || fd >= MAX_FDS || openFileTab[fd].file == NULL) // only pipes have wait queues
+      continue;
+
+    pipe_t *pipe = openFileTab[fd].file;
+    bool queued = false;
+    for (int j = 0; j < k; j++) // both ends of a pipe share one
+      queued = queued || (self->pollPipes[j] == pipe);
+
+    if (!queued)
+    {
+      pipe->pollq.pids[self->pid / 32] |= 1u << (self->pid % 32);
+      self->pollPipes[k++] = pipe;
+    }
+  }
+
+  self->pollFds = fds;
+  self->pollNfds = n;
+  self->pollNum = k;
+}
+
+// Remove a process from the wait queue of each pipe it polls; the caller must hold procLock and fileLock
+void poll_dequeue(pcb_t *p)
+{
+  for (int k = 0; k < p->pollNum; k++)
+    p->pollPipes[k]->pollq.pids[p->pid / 32] &= ~(1u << (p->pid % 32));
+
+  p->pollFds = NULL;
+  p->pollNfds = 0;
+  p->pollNum = 0;
+}
+
+// Abandon whatever a waiting process is waiting for, be it a futex, a pipe, a poll or a timeout
+void wait_cancel(pcb_t *p)
+{
+  futex_dequeue(p);
+  timer_cancel(&p->timer);
+
+  if (p->waitPipe != NULL)
+  {
+    spin_lock(&fileLock);
+    p->waitPipe->waiting--;
+    spin_unlock(&fileLock);
+    p->waitPipe = NULL;
+  }
+
+  if (p->pollFds != NULL)
+  {
+    spin_lock(&fileLock);
+    poll_dequeue(p);
+    spin_unlock(&fileLock);
+  }
+}
+
+// Wake a process whose sleep or timed wait has expired, with the return value set as it blocked
+void timeout_expired(ktimer_t *x)
+{
+  pcb_t *p = (pcb_t *)((uint8_t *)x - offsetof(pcb_t, timer));
+
+  if (p->status == STATUS_WAITING)
+  {
+    wait_cancel(p);
+    make_ready(p, &cpus[p->cpu]);
+  }
+}
+
+// Run the timer wheel tick iff. a timer is armed; the caller must hold procLock
+void wheel_update()
+{
+  hal_wheel(timer_pending() > 0);
+}
+
+/* Block the executing process (for at most ms, unless TIMEOUT_INFINITE);
+ * the caller must hold procLock.  The status changes under the run queue
+ * lock, iff. it is still executing: if another CPU killed the process after
+ * its system call began, the wait it has queued for is abandoned instead,
+ * so the kill is not overridden.
+ */
+void block(ctx_t *ctx, uint32_t ms)
+{
+  pcb_t *self = executing;
+  cpu_t *cpu = rq_lock(self);
+  bool killed = (self->status == STATUS_TERMINATED);
+
+  if (!killed)
+    self->status = STATUS_WAITING;
+
+  spin_unlock(&cpu->lock);
+
+  if (killed)
+    wait_cancel(self);
+  else if (ms != TIMEOUT_INFINITE)
+  {
+    timer_arm(&self->timer, TIMER_MS_TO_TICKS(ms) + 1); // +1 since the current tick is part-elapsed
+    wheel_update();
+  }
+
+  schedule(ctx);
+}
+
+/* Invalidate all entries in the process table, so it's clear they are not
+ * representing valid (i.e., active) processes, empty the futex wait queues,
+ * empty the process groups (so none has a quota), and initialise the open
+ * file table with the standard file descriptors.
+ * Each CPU has an empty run queue, and an idle process which executes idle
+ * in USR mode with IRQ interrupts enabled; only this CPU is online until
+ * the others have booted.
+ */
+void proc_init(uintptr_t idle)
+{
+  currentProcesses = 0;
+
+  for (int i = 0; i < MAX_PROCS; i++)
+  {
+    procTab[i].status = STATUS_INVALID;
+  }
+
+  for (int i = 0; i < FUTEX_BUCKETS; i++)
+  {
+    futexQueue[i] = -1;
+  }
+
+  for (int i = 0; i < MAX_CPUS; i++)
+  {
+    memset(&cpus[i], 0, sizeof(cpu_t));
+    cpus[i].id = i;
+    cpus[i].online = (i == cpu_id());
+    cpus[i].current = &cpus[i].idle;
+
+    cpus[i].idle.pid = -1;
+    cpus[i].idle.status = STATUS_READY;
+    cpus[i].idle.ctx.cpsr = 0x10;
+    cpus[i].idle.ctx.pc = idle;
+    cpus[i].idle.cpu = i;
+    cpus[i].idle.lastCpu = i;
+    cpus[i].idle.waitNext = -1;
+    cpus[i].idle.rqIndex = -1;
+
+    cpus[i].stamp = hal_counter();
+    cpus[i].execStamp = cpus[i].stamp;
+  }
+
+  for (int i = 0; i < MAX_GROUPS; i++)
+  {
+    memset(&groups[i], 0, sizeof(group_t));
+    groups[i].parked = -1;
+    groups[i].timer.fn = &group_refill;
+  }
+
+  for (int i = 0; i < MAX_FDS; i++)
+  {
+    if (i < 3)
+    {
+      openFileTab[i].refCount = 1;
+      if (i == 0)
+        openFileTab[i].flag = RDONLY;
+      else
+        openFileTab[i].flag = WRONLY;
+    }
+    else
+      openFileTab[i].refCount = 0;
+  }
+}
+
+/* Initialise a PCB, noting that the CPSR value of 0x10 means the processor
+ * is switched into USR mode, with IRQ and FIQ interrupts enabled, and the PC
+ * and SP values match the entry point and top of stack.
+ */
+pcb_t *proc_spawn(pid_t pid, uintptr_t pc, uintptr_t tos)
+{
+  pcb_t *p = &procTab[pid];
+
+  memset(p, 0, sizeof(pcb_t));
+  p->pid = pid;
+  p->status = STATUS_READY;
+  p->tos = tos;
+  p->ctx.cpsr = 0x10;
+  p->ctx.pc = pc;
+  p->ctx.sp = p->tos;
+  p->lastExec = time;
+  p->niceness = 0;
+  p->waitNext = -1;
+  p->cpu = cpu_id();
+  p->lastCpu = cpu_id();
+  p->rqIndex = -1;
+  p->groupNext = -1;
+  p->timer.fn = &timeout_expired;
+  for (int i = 0; i < MAX_FDS; i++)
+    p->fdTab[i] = -1;
+
+  currentProcesses++;
+
+  return p;
+}
+
+/* A terminated process' slot can only be reused once its CPU has switched
+ * away from it: kill marks a process executing on another CPU terminated,
+ * but that CPU may not invoke the scheduler for a while (e.g., if it is in
+ * a long system call), and then dispatch preserves the process' context in,
+ * and schedule updates, its PCB.  Both happen holding the CPU's run queue
+ * lock, so once it is no longer current there, the slot is free.
+ */
+bool proc_reusable(pcb_t *p)
+{
+  if (p->status == STATUS_INVALID) // never used
+    return true;
+  if (p->status != STATUS_TERMINATED)
+    return false;
+
+  cpu_t *cpu = rq_lock(p);
+  bool current = (cpu->current == p);
+  spin_unlock(&cpu->lock);
+
+  return !current;
+}
+
+pid_t proc_fork(ctx_t *ctx)
+{
+  int iNew = -1;
+
+  // search for an unused slot in the table
+  for (int i = 1; i < MAX_PROCS && iNew < 0; i++)
+  {
+    if (proc_reusable(&procTab[i]))
+      iNew = i;
+  }
+
+  if (iNew < 0) // process table full
+  {
+    print("\nERR: process table full", 24);
+
+    return -1;
+  }
+
+  currentProcesses++;
+
+  memset(&procTab[iNew], 0, sizeof(pcb_t)); // initialise 0-th PCB
+
+  procTab[iNew].pid = (pid_t)(iNew);
+  procTab[iNew].status = STATUS_CREATED;
+  procTab[iNew].tos = hal_stack(iNew);
+
+  memcpy(&procTab[iNew].ctx, ctx, sizeof(ctx_t)); // replicate state of parent - copy execution context
+
+  // set child stack pointer to same height as parent's stack pointer
+  uintptr_t stackHeight = executing->tos - executing->ctx.sp;
+  procTab[iNew].ctx.sp = procTab[iNew].tos - stackHeight;
+  memcpy( (uint32_t*) (procTab[ iNew ].ctx.sp), (uint32_t*) ctx->sp , stackHeight);
+
+  procTab[iNew].lastExec = time;                  // time counter reset
+  procTab[iNew].niceness = executing->niceness;   // copy parent niceness
+  procTab[iNew].policy = executing->policy;       // copy parent scheduling class and priority
+  procTab[iNew].rtPriority = executing->rtPriority;
+  procTab[iNew].group = executing->group;         // copy parent process group
+  procTab[iNew].groupNext = -1;                   // not parked
+  procTab[iNew].waitNext = -1;                    // not in any wait queue
+  procTab[iNew].lastCpu = -1;                     // not yet executed, so no cache state
+  procTab[iNew].rqIndex = -1;                     // not in any run queue
+  procTab[iNew].timer.fn = &timeout_expired;
+
+  // copy parent fd table, update open file table reference counts
+  spin_lock(&fileLock);
+  for (int i = 0; i < MAX_FDS; i++)
+  {
+    int fd = executing->fdTab[i];
+    procTab[iNew].fdTab[i] = fd;
+    if (fd >= 0)
+      openFileTab[fd].refCount++;
+  }
+  spin_unlock(&fileLock);
+
+  trace(TRACE_FORK, executing->pid, procTab[iNew].pid, 0);
+
+  ctx->gpr[0] = procTab[iNew].pid; // parent return value = child PID
+  procTab[iNew].ctx.gpr[0] = 0;    // child return value = 0
+
+  make_ready(&procTab[iNew], cpu_least_loaded()); // spread processes over CPUs
+
+  return procTab[iNew].pid;
+}
@@ -0,0 +1,308 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PROC_H
+#define __PROC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string.h>
+
+#include     "hal.h"
+#include     "smp.h"
+#include   "timer.h"
+#include   "trace.h"
+
+/* The kernel source code is made simpler and more consistent by using
+ * some human-readable type definitions:
+ *
+ * - a type that captures a Process IDentifier (PID), which is really
+ *   just an integer,
+ * - an enumerated type that captures the status of a process, e.g.,
+ *   whether it is currently executing,
+ * - a type that captures each component of an execution context (i.e.,
+ *   processor state) in a compatible order wrt. the low-level handler
+ *   preservation and restoration prologue and epilogue,
+ * - a type that captures the resource usage of a process, i.e., the time
+ *   (in 24MHz counter cycles) spent executing in user mode, kernel mode and
+ *   handling interrupts, counts of voluntary (i.e., on blocking, yielding
+ *   or terminating) and involuntary (i.e., on preemption) context switches,
+ *   counts of each system call made, and the latency from being woken to
+ *   executing,
+ * - a type that captures a wait queue, which a process blocked in poll
+ *   is in for each pipe it polls (so a write, read or close which could
+ *   make a polled fd ready wakes it to check),
+ * - a type that captures a process PCB,
+ * - a type that captures a process group, whose processes are together
+ *   limited to a quota of CPU time per period (e.g., so a batch job can
+ *   not starve the console), and
+ * - a type that captures the state of each CPU (i.e., core), including
+ *   the process it is executing and its queue of ready processes, which
+ *   is a min-heap ordered by class then priority or virtual runtime (see
+ *   schedule).
+ *
+ * Registers, and other fields which may hold an address, are uintptr_t: on
+ * the target this is 32-bit, but on a (64-bit) host build it is wide enough
+ * for a pointer.
+ */
+
+#define MAX_PROCS 100
+#define MAX_FDS 128
+#define BUFFER_SIZE 9
+
+#define BALANCE_PERIOD 4            // timer ticks between run queue rebalancing
+#define CACHE_HOT_TIME (2*MAX_CPUS) // time since execution a process is assumed to have a hot cache
+
+#if !defined( MAX_SVCS ) // system call IDs whose use is counted, per Makefile (which also passes it to lolevel.s)
+#define MAX_SVCS 32
+#endif
+
+#define NICE_MIN (-19)
+#define NICE_MAX ( 20)
+
+#define SCHED_WAKE_CREDIT 12000000 // virtual runtime (in cycles, i.e., ~0.5 sec) a woken process may lag its run queue
+#define SCHED_WAKE_GRAN      24000 // virtual runtime (in cycles, i.e., ~1 ms) a woken process must lead by to preempt
+
+#define SCHED_NORMAL 0 // scheduling classes, i.e., weighted fair
+#define SCHED_FIFO   1 //                        real-time, until it blocks or yields
+#define SCHED_RR     2 //                        real-time, round-robin among equal priority
+
+#define MAX_GROUPS 8 // process groups, where group 0 (the default) has no quota
+
+#define SCHED_RT_MAX   99       // maximum real-time priority (the minimum being 1)
+#define SCHED_RR_SLICE 12000000 // execution time (in cycles, i.e., ~0.5 sec) of a SCHED_RR process before it yields to one of equal priority
+
+#define FUTEX_BUCKETS 16
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+#define FUTEX_WAIT_TIMED 2
+
+#define POLL_MAX 16 // maximum number of fds per poll
+
+#define POLLIN   0x001 // data can be read without blocking
+#define POLLOUT  0x004 // data can be written without blocking
+#define POLLERR  0x008 // error, e.g., no read end is open for a pipe write end
+#define POLLHUP  0x010 // hang up, i.e., no write end is open for a pipe read end
+#define POLLNVAL 0x020 // fd is not open
+
+typedef int pid_t;
+
+typedef enum {
+  STATUS_INVALID,
+
+  STATUS_CREATED,
+  STATUS_TERMINATED,
+
+  STATUS_READY,
+  STATUS_EXECUTING,
+  STATUS_WAITING
+} status_t;
+
+typedef enum {
+  RDONLY,
+  WRONLY,
+  RDWR
+} fdstatus_t;
+
+typedef struct {
+  uintptr_t cpsr, pc, gpr[ 13 ], sp, lr;
+#if STRING_IMPL == 2
+  uint32_t neon[ 16 ]; // d0...d7, as used by the NEON string functions
+#endif
+} ctx_t;
+
+// a wait queue, as a bitmap of PIDs so a process can be in several at once (e.g., via poll); modified holding procLock and fileLock, so either suffices to read it
+typedef struct {
+  uint32_t pids[(MAX_PROCS + 31) / 32];
+} waitq_t;
+
+typedef struct {
+  char buffer[BUFFER_SIZE];
+  int  front, rear, size;
+  bool full;
+  int  waiting; // number of processes blocked reading
+  int  readers; // number of open read  ends, i.e., open file table entries
+  int  writers; // number of open write ends
+  waitq_t pollq; // processes blocked polling the pipe
+  int  pins;    // number of pending pipe_wake calls, each of which keeps it allocated
+} pipe_t;
+
+// an fd polled, the events of interest, and the events returned (POLL*); the layout must match struct pollfd in user/libc.h
+typedef struct {
+  int     fd;
+  int16_t events;
+  int16_t revents;
+} pollfd_t;
+
+typedef struct {
+  pipe_t*    file;
+  fdstatus_t flag;
+  int        refCount;
+} fd_t;
+
+typedef struct {
+uint64_t     userCycles; // time executing in user mode
+uint64_t   kernelCycles; // time executing system calls
+uint64_t      irqCycles; // time executing interrupt handlers, while executing
+uint32_t          nvcsw; // number of   voluntary context switches
+uint32_t         nivcsw; // number of involuntary context switches
+uint32_t svcCount[MAX_SVCS]; // number of calls, per system call ID
+uint64_t     wakeCycles; // total time from being made ready to executing
+uint32_t        wakeMax; // maximum time from being made ready to executing
+uint32_t        wakeNum; // number of times made ready then executed
+} pstats_t;
+
+typedef struct {
+    pid_t           pid; // Process IDentifier (PID)
+ status_t        status; // current status
+uintptr_t           tos; // address of Top of Stack (ToS)
+    ctx_t           ctx; // execution context
+ uint32_t      lastExec; // time of last execution, which determines whether its cache is hot
+ uint32_t      niceness; // base priority value, which determines the weight
+ uint64_t      vruntime; // virtual runtime, i.e., execution time (in cycles) scaled by 1024 / weight
+      int        policy; // scheduling class, i.e., SCHED_NORMAL, SCHED_FIFO or SCHED_RR
+      int    rtPriority; // real-time priority (higher first), or 0 iff. SCHED_NORMAL
+ uint32_t         rqSeq; // order of queueing, among real-time processes of equal priority
+ uint32_t        rrUsed; // execution time of a SCHED_RR process in its current slice
+ uint32_t     wakeStamp; // 24MHz counter when made ready
+     bool         woken; // made ready, but not yet executed since
+      int         group; // process group
+      int     groupNext; // PID of next process parked by its group, -1 if last
+      int fdTab[MAX_FDS]; // process file descriptor table
+uintptr_t     futexAddr; // address blocked on by futex wait
+      int      waitNext; // PID of next process in wait queue, -1 if last
+      int           cpu; // CPU whose run queue holds (or is executing) the process
+      int       lastCpu; // CPU which last executed the process, -1 if none
+      int       rqIndex; // index in run queue heap, -1 if not queued
+ ktimer_t         timer; // timeout of sleep or timed wait
+  pipe_t*      waitPipe; // pipe blocked reading from, NULL if none
+pollfd_t*       pollFds; // fds blocked polling, NULL if none
+      int      pollNfds; // number of fds blocked polling
+  pipe_t* pollPipes[POLL_MAX]; // pipes whose wait queues the process is in, while blocked polling
+      int      pollNum; // number of such pipes
+     bool      yielding; // invoked the scheduler by yielding
+ pstats_t         stats; // resource usage
+} pcb_t;
+
+typedef struct {
+uint32_t          quota; // CPU time (in cycles, over all CPUs) its processes may use per period, 0 if unlimited
+uint32_t         period; // period (in ms)
+uint32_t           used; // CPU time used in the current period
+    bool      throttled; // quota used up, so its processes are parked until the next period
+     int         parked; // PID at head of list of parked processes, -1 if empty
+ktimer_t          timer; // end of the current period
+uint64_t      usedTotal; // CPU time used in total
+uint32_t      throttles; // number of periods in which its quota was used up
+} group_t;
+
+typedef struct {
+spinlock_t         lock; // guards run queue, plus status of processes in it
+     int             id; // CPU ID, per MPIDR
+    bool         online; // booted and scheduling
+  pcb_t*        current; // currently executing process
+   pcb_t           idle; // idle process, executed iff. nothing else is ready
+     int ready[MAX_PROCS]; // run queue, as a min-heap of PIDs (see rq_before)
+     int       readyNum; // number of processes in run queue
+uint64_t    minVruntime; // monotonic lower bound on virtual runtime of the processes executing or ready
+uint32_t          stamp; // 24MHz counter at last accounting point
+uint32_t      execStamp; // 24MHz counter at last virtual runtime charge
+uint32_t          rqSeq; // next queueing order, for real-time processes
+} cpu_t;
+
+extern int currentProcesses;
+extern uint32_t time;
+
+extern pcb_t procTab[MAX_PROCS];
+extern fd_t openFileTab[MAX_FDS];
+
+extern int futexQueue[FUTEX_BUCKETS];
+
+extern cpu_t cpus[MAX_CPUS];
+
+extern group_t groups[MAX_GROUPS];
+
+extern spinlock_t procLock;
+extern spinlock_t fileLock;
+extern spinlock_t groupLock;
+
+// per CPU, non-zero iff. the executing process should be preempted before returning to USR mode (checked by lolevel.s)
+extern volatile uint32_t needResched[MAX_CPUS];
+
+// the process executing on this CPU
+#define executing ( cpus[ cpu_id() ].current )
+
+// print an n character string to the terminal
+extern void print(char *x, int n);
+
+// initialise the process table, futex wait queues, open file table, and each CPU with its idle process (which executes idle)
+extern void proc_init(uintptr_t idle);
+// initialise PCB pid to execute from pc with stack tos, queued on this CPU
+extern pcb_t *proc_spawn(pid_t pid, uintptr_t pc, uintptr_t tos);
+// return true iff. the slot of process p can be reused, i.e., it never executed, or terminated and its CPU has switched away from it; the caller must hold procLock
+extern bool proc_reusable(pcb_t *p);
+// fork the executing process, whose context is ctx, returning the child PID, or -1 if the process table is full; the caller must hold procLock
+extern pid_t proc_fork(ctx_t *ctx);
+
+// context switch from the previous to the next process, recording it in the trace
+extern void dispatch(ctx_t *ctx, pcb_t *prev, pcb_t *next);
+// select the next process to execute on this CPU, and switch to it
+extern void schedule(ctx_t *ctx);
+// set the scheduling class and real-time priority of process p, returning 0, or -1 if they are invalid
+extern int sched_set(pcb_t *p, int policy, int priority);
+
+extern void rq_insert(cpu_t *cpu, pcb_t *p);
+extern void rq_remove(cpu_t *cpu, pcb_t *p);
+extern pcb_t *rq_first(cpu_t *cpu);
+extern cpu_t *rq_lock(pcb_t *p);
+extern void rq_balance();
+
+extern void cpu_kick(int id);
+extern cpu_t *cpu_least_loaded();
+extern void make_ready(pcb_t *p, cpu_t *cpu);
+
+// move process p into group gid; the caller must hold procLock
+extern void group_move(pcb_t *p, int gid);
+// limit group gid to quota cycles of CPU time per period ms, or remove its limit iff. quota = 0; the caller must hold procLock
+extern void group_limit(int gid, uint32_t quota, uint32_t period);
+// remove process p from the list of processes parked by its group, returning true iff. it was in it
+extern bool group_remove(pcb_t *p);
+// preempt any process executing whose group has used up its quota; invoked on each timer wheel tick, so the caller must hold procLock
+extern void group_enforce();
+
+extern int open_fd(pipe_t *p, int flag);
+extern int close_fd(int fd, pid_t pid);
+
+// allocate an empty pipe, with neither end open
+extern pipe_t *pipe_alloc();
+extern int pipe_read(pipe_t *pipe, char *x, int n);
+extern int pipe_write(pipe_t *pipe, char *x, int n);
+// wake processes blocked on a pipe, which the caller pinned (i.e., incremented pins) holding fileLock; then unpin it, freeing it iff. unused
+extern void pipe_wake(pipe_t *pipe);
+// return true iff. a pipe can be freed, i.e., neither end is open and no pipe_wake is pending; the caller must hold fileLock
+extern bool pipe_unused(pipe_t *pipe);
+
+// return true iff. no process is in wait queue q
+extern bool waitq_empty(waitq_t *q);
+// set the revents of the n fds at fds, returning the number which have any; the caller must hold fileLock
+extern int poll_scan(pollfd_t *fds, int n);
+// add the executing process to the wait queue of each pipe among the n fds at fds; the caller must hold procLock and fileLock
+extern void poll_enqueue(pollfd_t *fds, int n);
+// remove process p from every wait queue it is in via poll; the caller must hold procLock and fileLock
+extern void poll_dequeue(pcb_t *p);
+
+extern void futex_enqueue(pcb_t *p, uintptr_t addr);
+extern void futex_dequeue(pcb_t *p);
+extern int futex_wake(uintptr_t addr, int n);
+
+extern void wait_cancel(pcb_t *p);
+extern void wheel_update();
+extern void block(ctx_t *ctx, uint32_t ms);
+
+#endif
@@ -0,0 +1,136 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "profile.h"
+
+profile_entry_t profTab[ PROFILE_SLOTS ];
+
+uint32_t   profSamples = 0;
+uint32_t   profLost    = 0;
+uint32_t   profCycles  = 0; // PMU cycle counter at start, then elapsed cycles once stopped
+bool       profOn      = false;
+
+spinlock_t profLock    = 0;
+
+void profile_start( uint32_t us ) {
+  spin_lock( &profLock );
+
+  for( int i = 0; i < PROFILE_SLOTS; i++ ) {
+    profTab[ i ].count = 0;
+  }
+
+  profSamples = 0;
+  profLost    = 0;
+  profCycles  = pmu_cycles();
+  profOn      = true;
+
+  spin_unlock( &profLock );
+
+  TIMER1->Timer1Load  = ( us > 0 ) ? us : 1; // select period = us microseconds
+  TIMER1->Timer1Ctrl  = 0x00000002; // select 32-bit   timer
+  TIMER1->Timer1Ctrl |= 0x00000040; // select periodic timer
+  TIMER1->Timer1Ctrl |= 0x00000020; // enable          timer interrupt
+  TIMER1->Timer1Ctrl |= 0x00000080; // enable          timer
+}
+
+void profile_stop() {
+  TIMER1->Timer1Ctrl &= ~0x00000080; // disable timer
+
+  spin_lock( &profLock );
+
+  if( profOn ) {
+    profCycles = pmu_cycles() - profCycles;
+    profOn     = false;
+  }
+
+  spin_unlock( &profLock );
+}
+
+void profile_sample( uint32_t pc, int pid ) {
+  spin_lock( &profLock );
+
+  if( profOn ) {
+    profSamples++;
+
+    uint32_t h = ( ( pc >> 2 ) ^ ( pid * 0x9E3779B1 ) ) & ( PROFILE_SLOTS - 1 );
+
+    for( int i = 0; i < PROFILE_SLOTS; i++, h = ( h + 1 ) & ( PROFILE_SLOTS - 1 ) ) {
+      profile_entry_t* e = &profTab[ h ];
+
+      if( e->count == 0 ) {
+        e->pc = pc; e->pid = pid; e->count = 1; break;
+      }
+      if( ( e->pc == pc ) && ( e->pid == pid ) ) {
+        e->count++; break;
+      }
+      if( i == ( PROFILE_SLOTS - 1 ) ) {
+        profLost++;
+      }
+    }
+  }
+
+  spin_unlock( &profLock );
+}
+
+// transmit x via UART0 as 8 hexadecimal digits, then a separator c
+void profile_puth( uint32_t x, char c ) {
+  for( int i = 28; i >= 0; i -= 4 ) {
+    PL011_putc( UART0, itox( ( x >> i ) & 0xF ), true );
+  }
+
+  PL011_putc( UART0, c, true );
+}
+
+int  profile_dump( bool f ) {
+  int n = 0;
+
+  profile_stop();
+
+  if( !f ) {
+    PL011_putc( UART0, '\n', true );
+    for( char* x = "#profile "; *x != '\x00'; x++ ) {
+      PL011_putc( UART0, *x, true );
+    }
+    profile_puth( profSamples, ' ' );
+    profile_puth( profLost,    ' ' );
+    profile_puth( profCycles, '\n' );
+  }
+
+  for( int i = 0; i < PROFILE_SLOTS; i++ ) {
+    profile_entry_t* e = &profTab[ i ];
+
+    if( e->count == 0 ) {
+      continue;
+    }
+
+    n++;
+
+    if( !f ) {
+      profile_puth( e->pc,    ' ' );
+      profile_puth( e->pid,   ' ' );
+      profile_puth( e->count, '\n' );
+    }
+    else if( disk_wr( n, ( const uint8_t* )( e ), sizeof( profile_entry_t ) ) < 0 ) {
+      return -1;
+    }
+  }
+
+  if( !f ) {
+    for( char* x = "#end\n"; *x != '\x00'; x++ ) {
+      PL011_putc( UART0, *x, true );
+    }
+  }
+  else {
+    uint32_t header[ 4 ] = { PROFILE_MAGIC, n, profSamples, profLost };
+
+    if( disk_wr( 0, ( const uint8_t* )( header ), sizeof( header ) ) < 0 ) {
+      return -1;
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,70 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include   "GIC.h"
+#include "PL011.h"
+#include "SP804.h"
+#include  "disk.h"
+
+#include   "smp.h"
+#include   "pmu.h"
+
+/* A sampling profiler: while it is running, the first channel of TIMER1
+ * interrupts CPU 0 periodically, which samples the PC and PID of the
+ * process it interrupted, then forwards the interrupt to any other CPUs
+ * (as an IPI) so they do likewise.
+ *
+ * Samples are accumulated in a histogram, i.e., a hash table (with linear
+ * probing) which counts samples per (PC, PID) pair; if it is full, then a
+ * sample is dropped and counted as lost.  The histogram is dumped either
+ * to UART0, as lines
+ *
+ * #profile <samples> <lost> <cycles>
+ * <PC> <PID> <count>
+ * ...
+ * #end
+ *
+ * (in hexadecimal, where cycles is per the PMU of CPU 0), or to the disk,
+ * as one entry per block (where block 0 is a header): profile.py turns
+ * either into a flat profile, using the symbols in image.elf.
+ */
+
+#define PROFILE_SLOTS  ( 1024 ) // histogram entries, which must be a power of 2
+#define PROFILE_MAGIC  ( 0x464F5250 ) // "PROF", marking a disk dump
+
+#define IPI_PROFILE    ( GIC_SOURCE_SGI0 + 1 )// SGI asking a core to take a sample
+
+// operations of profile system call
+#define PROFILE_OP_START ( 0 )
+#define PROFILE_OP_STOP  ( 1 )
+#define PROFILE_OP_DUMP  ( 2 )
+#define PROFILE_OP_DISK  ( 3 )
+
+typedef struct {
+  uint32_t    pc;
+  int32_t    pid;
+  uint32_t count; // samples, 0 iff. entry unused
+  uint32_t   rsv; // reserved, so an entry fills one (16-byte) disk block
+} profile_entry_t;
+
+// start profiling, with a sample every us microseconds (clearing any previous samples)
+extern void profile_start( uint32_t us );
+// stop  profiling
+extern void profile_stop();
+// record a sample of pc for process pid
+extern void profile_sample( uint32_t pc, int pid );
+// dump samples to UART0 (iff. f = false) or the disk (iff. f = true); return number of entries, or -1 on failure
+extern int  profile_dump( bool f );
+
+#endif
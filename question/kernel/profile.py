@@ -0,0 +1,112 @@
+# Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+#
+# Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+# which can be found via http://creativecommons.org (and should be included as 
+# LICENSE.txt within the associated archive or repository).
+
+import argparse, bisect, struct, subprocess, sys
+
+PROFILE_MAGIC = 0x464F5250
+
+# A dump written to UART0 is a block of lines, delimited by #profile and
+# #end, within a log of the terminal: if there are several, use the last.
+
+def load_uart( f ) :
+  entries = None ; header = None
+
+  for line in open( f, 'r' ) :
+    t = line.strip().split( ' ' )
+
+    if   ( t[ 0 ] == '#profile' ) :
+      entries = [] ; header = [ int( x, 16 ) for x in t[ 1 : ] ]
+    elif ( t[ 0 ] == '#end'     ) :
+      break
+    elif ( entries != None and len( t ) == 3 ) :
+      pc, pid, count = [ int( x, 16 ) for x in t ]
+
+      entries.append( ( pc, struct.unpack( '<i', struct.pack( '<I', pid ) )[ 0 ], count ) )
+
+  if ( entries == None ) :
+    raise Exception( 'no profile found in %s' % ( f ) )
+
+  return ( header[ 0 ], header[ 1 ], entries )
+
+# A dump written to the disk is a header block, then one entry per block.
+
+def load_disk( f, block_len ) :
+  fd = open( f, 'rb' )
+
+  magic, n, samples, lost = struct.unpack( '<4I', fd.read( 16 ) )
+
+  if ( magic != PROFILE_MAGIC ) :
+    raise Exception( 'no profile found in %s' % ( f ) )
+
+  entries = []
+
+  for i in range( 1, n + 1 ) :
+    fd.seek( i * block_len )
+
+    pc, pid, count, _ = struct.unpack( '<IiII', fd.read( 16 ) )
+
+    entries.append( ( pc, pid, count ) )
+
+  return ( samples, lost, entries )
+
+# Symbols are read (sorted by address) from the image via nm, so each PC
+# maps to the closest function symbol at or below it.
+
+def load_symbols( elf, nm ) :
+  syms = []
+
+  for line in subprocess.check_output( [ nm, '-n', elf ] ).decode().splitlines() :
+    t = line.split()
+
+    if ( len( t ) == 3 and t[ 1 ] in 'tT' ) :
+      syms.append( ( int( t[ 0 ], 16 ), t[ 2 ] ) )
+
+  return syms
+
+def symbolise( syms, pc ) :
+  i = bisect.bisect_right( [ a for ( a, _ ) in syms ], pc ) - 1
+
+  return syms[ i ][ 1 ] if ( i >= 0 ) else '0x%08X' % ( pc )
+
+if ( __name__ == '__main__' ) :
+  # parse command line arguments
+
+  parser = argparse.ArgumentParser()
+
+  parser.add_argument( '--elf',       type =  str, action = 'store', default = 'image.elf' )
+  parser.add_argument( '--nm',        type =  str, action = 'store', default = 'arm-eabi-nm' )
+
+  parser.add_argument( '--uart',      type =  str, action = 'store'      )
+  parser.add_argument( '--disk',      type =  str, action = 'store'      )
+  parser.add_argument( '--block-len', type =  int, action = 'store', default = 16 )
+
+  parser.add_argument( '--by-pid',                 action = 'store_true' )
+
+  args = parser.parse_args()
+
+  if   ( args.uart != None ) :
+    samples, lost, entries = load_uart( args.uart )
+  elif ( args.disk != None ) :
+    samples, lost, entries = load_disk( args.disk, args.block_len )
+  else :
+    parser.error( 'either --uart or --disk is required' )
+
+  syms = load_symbols( args.elf, args.nm )
+
+  # accumulate samples per function (and PID, if required), then print a flat profile
+
+  hist = {}
+
+  for ( pc, pid, count ) in entries :
+    k = ( symbolise( syms, pc ), pid if ( args.by_pid ) else None )
+
+    hist[ k ] = hist.get( k, 0 ) + count
+
+  print( '%d samples, %d lost' % ( samples, lost ) )
+  print( '%7s %6s %5s  %s' % ( 'SAMPLES', '%', 'PID', 'FUNCTION' ) )
+
+  for ( ( f, pid ), count ) in sorted( hist.items(), key = lambda x : -x[ 1 ] ) :
+    print( '%7d %6.2f %5s  %s' % ( count, 100.0 * count / max( samples, 1 ), 'I' if ( pid == -1 ) else ( '' if ( pid == None ) else str( pid ) ), f ) )
@@ -0,0 +1,419 @@
+# Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+#
+# Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+# which can be found via http://creativecommons.org (and should be included as
+# LICENSE.txt within the associated archive or repository).
+
+import argparse, heapq, json, random, sys
+
+# A deterministic, discrete-event simulation of one CPU, which replays a
+# workload against a scheduling policy.  Time is in microseconds.  As in the
+# kernel, the scheduler is invoked on each timer tick, and when the executing
+# process yields, blocks or exits; a process which becomes ready while the
+# CPU is idle is dispatched at once, but otherwise waits to be picked.
+#
+# A workload is a list of processes, each with an arrival time, niceness and
+# a list of bursts [ cpu, wait ]: the process executes for cpu, then yields
+# (iff. wait = 0), blocks for wait (iff. wait > 0) or terminates (iff. wait
+# is None).
+
+TICK = 1048576 # TIMER0 period, i.e., 2^20 ticks at 1MHz
+
+# weights per niceness (as in Linux, so each step is ~1.25x), for niceness
+# -20...19: a niceness beyond that range is clamped.
+
+WEIGHTS = [ 88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+             9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,  1586,  1277,
+             1024,   820,   655,   526,   423,   335,   272,   215,   172,   137,
+              110,    87,    70,    56,    45,    36,    29,    23,    18,    15 ]
+
+def weight( nice ) :
+  return WEIGHTS[ min( max( nice, -20 ), 19 ) + 20 ]
+
+class Proc :
+  def __init__( self, pid, arrive, nice, bursts, exits ) :
+    self.pid    = pid    ; self.arrive = arrive ; self.nice  = nice
+    self.bursts = bursts ; self.exits  = exits  ; self.i     = 0
+    self.left   = bursts[ 0 ][ 0 ] if ( bursts ) else 0
+
+    self.cpu    = 0      ; self.finish = None   ; self.since = None
+    self.nvcsw  = 0      ; self.nivcsw = 0      ; self.waits = []
+
+# Each policy holds the ready processes (excluding the executing one), and
+# implements
+#
+# - add( t, p ):            p became ready, i.e., arrived or woke up,
+# - pick( t, prev, why ):   select the next process, where prev is the one
+#                           executing (None if idle) and why is one of 'tick',
+#                           'yield', 'block' or 'exit'; iff. prev is still
+#                           ready (i.e., why is 'tick' or 'yield') and not
+#                           selected, the policy keeps it as ready,
+# - charge( p, dt ):        p executed for dt.
+
+class Current :
+  # the kernel heuristic: select the process maximising (time - lastExec)
+  # - niceness, where time counts scheduler invocations, favouring prev by 1
+
+  def __init__( self, args ) :
+    self.queue = [] ; self.time = 0 ; self.last = {}
+
+  def add( self, t, p ) :
+    self.queue.append( p ) ; self.last.setdefault( p.pid, self.time )
+
+  def pick( self, t, prev, why ) :
+    ready = ( why in [ 'tick', 'yield' ] )
+    best  = prev if ( ready ) else None ; high = ( prev.nice - 1 ) if ( ready ) else None
+
+    for p in self.queue :
+      x = ( self.time - self.last[ p.pid ] ) - p.nice
+
+      if ( high == None or x >= high ) :
+        best = p ; high = x
+
+    if ( best != None and best != prev ) :
+      self.queue.remove( best )
+    if ( ready and best != prev ) :
+      self.queue.append( prev )
+    if ( prev != None ) :
+      self.last[ prev.pid ] = self.time
+
+    self.time += 1
+
+    return best
+
+  def charge( self, p, dt ) :
+    pass
+
+class MLFQ :
+  # multi-level feedback queue: a process is demoted once it uses the quantum
+  # of its level (which doubles per level), keeps its level if it yields or
+  # blocks, and all are periodically boosted to the top level
+
+  def __init__( self, args ) :
+    self.levels = [ [] for i in range( args.mlfq_levels ) ] ; self.level = {} ; self.used = {}
+    self.boost  = args.mlfq_boost ; self.ticks = 0
+
+  def add( self, t, p ) :
+    l = self.level.setdefault( p.pid, 0 ) ; self.used[ p.pid ] = 0 ; self.levels[ l ].append( p )
+
+  def pick( self, t, prev, why ) :
+    if ( why == 'tick' ) :
+      self.ticks += 1
+
+      if ( self.ticks % self.boost == 0 ) :
+        for q in self.levels[ 1 : ] :
+          self.levels[ 0 ] += q ; del q[ : ]
+        for pid in self.level :
+          self.level[ pid ] = 0
+
+    if ( why in [ 'tick', 'yield' ] ) :
+      l = self.level[ prev.pid ]
+
+      if ( why == 'tick' ) :
+        self.used[ prev.pid ] += 1
+
+        if ( self.used[ prev.pid ] >= ( 1 << l ) ) :
+          l = self.level[ prev.pid ] = min( l + 1, len( self.levels ) - 1 ) ; self.used[ prev.pid ] = 0
+        elif ( not any( self.levels[ : l + 1 ] ) ) :
+          return prev # quantum not used, and nothing of higher or equal level ready
+
+      self.levels[ l ].append( prev )
+
+    for q in self.levels :
+      if ( q ) :
+        return q.pop( 0 )
+
+    return None
+
+  def charge( self, p, dt ) :
+    pass
+
+class CFS :
+  # weighted fair queueing: each process accrues virtual runtime at a rate
+  # inversely proportional to its weight, and that with the least is picked;
+  # the executing process is only preempted once it leads by a granularity,
+  # and a process which wakes up is placed no more than a latency behind
+
+  def __init__( self, args ) :
+    self.queue = [] ; self.vrt = {} ; self.min = 0 ; self.seq = 0
+    self.gran  = args.cfs_granularity ; self.latency = args.cfs_latency
+
+  def add( self, t, p ) :
+    self.vrt[ p.pid ] = max( self.vrt.get( p.pid, 0 ), self.min - self.latency )
+    self.push( p )
+
+  def push( self, p ) :
+    heapq.heappush( self.queue, ( self.vrt[ p.pid ], self.seq, p ) ) ; self.seq += 1
+
+  def pick( self, t, prev, why ) :
+    if ( why in [ 'tick', 'yield' ] ) :
+      if ( why == 'tick' and ( not self.queue or self.vrt[ prev.pid ] < self.queue[ 0 ][ 0 ] + self.gran ) ) :
+        return prev
+
+      self.push( prev )
+
+    if ( not self.queue ) :
+      return None
+
+    p = heapq.heappop( self.queue )[ 2 ] ; self.min = max( self.min, self.vrt[ p.pid ] )
+
+    return p
+
+  def charge( self, p, dt ) :
+    self.vrt[ p.pid ] += dt * 1024.0 / weight( p.nice )
+
+class Lottery :
+  # proportional share: each pick is a draw, with tickets per weight
+
+  def __init__( self, args ) :
+    self.queue = [] ; self.rng = random.Random( args.seed )
+
+  def add( self, t, p ) :
+    self.queue.append( p )
+
+  def pick( self, t, prev, why ) :
+    if ( why in [ 'tick', 'yield' ] ) :
+      self.queue.append( prev )
+    if ( not self.queue ) :
+      return None
+
+    x = self.rng.uniform( 0, sum( weight( p.nice ) for p in self.queue ) )
+
+    for p in self.queue :
+      x -= weight( p.nice )
+
+      if ( x <= 0 ) :
+        break
+
+    self.queue.remove( p )
+
+    return p
+
+  def charge( self, p, dt ) :
+    pass
+
+POLICIES = { 'current' : Current, 'mlfq' : MLFQ, 'cfs' : CFS, 'lottery' : Lottery }
+
+def simulate( procs, policy, tick, horizon ) :
+  events = [ ( p.arrive, p.pid, p ) for p in procs ] ; heapq.heapify( events )
+  t = 0 ; prev = None ; switches = 0 ; nextTick = tick
+
+  def dispatch( why ) :
+    nonlocal prev, switches
+
+    p = policy.pick( t, prev, why )
+
+    if ( p != prev ) :
+      if ( prev != None and why == 'tick' ) :
+        prev.nivcsw += 1 ; prev.since = t
+      elif ( prev != None ) :
+        prev.nvcsw  += 1 ; prev.since = t if ( why == 'yield' ) else None
+
+      switches += 1
+    elif ( why == 'yield' ) :
+      prev.nvcsw  += 1
+
+    if ( p != None and p.since != None ) :
+      p.waits.append( t - p.since ) ; p.since = None
+
+    prev = p
+
+  while ( t < horizon and ( prev != None or events ) ) :
+    # advance to the next event, i.e., a tick, an arrival or wake up, or the end of the burst executing
+
+    u = min( nextTick, events[ 0 ][ 0 ] if ( events ) else horizon, horizon )
+
+    if ( prev != None ) :
+      u = min( u, t + prev.left ) ; prev.left -= u - t ; prev.cpu += u - t ; policy.charge( prev, u - t )
+
+    t = u ; why = None
+
+    if ( prev != None and prev.left == 0 ) :
+      cpu, wait = prev.bursts[ prev.i ] ; prev.i += 1
+
+      if   ( wait == None or prev.i >= len( prev.bursts ) ) :
+        prev.finish = t ; why = 'exit'
+      elif ( wait > 0 ) :
+        heapq.heappush( events, ( t + wait, prev.pid, prev ) ) ; why = 'block'
+      else :
+        why = 'yield'
+
+      if ( prev.i < len( prev.bursts ) ) :
+        prev.left = prev.bursts[ prev.i ][ 0 ]
+
+    while ( events and events[ 0 ][ 0 ] <= t ) :
+      p = heapq.heappop( events )[ 2 ] ; p.since = t ; policy.add( t, p )
+
+    if ( t >= nextTick ) :
+      nextTick += tick ; why = why or ( 'tick' if ( prev != None ) else None )
+
+    if ( why != None or prev == None ) :
+      dispatch( why )
+
+  return ( t, switches )
+
+def percentile( x, q ) :
+  return sorted( x )[ min( int( q * len( x ) ), len( x ) - 1 ) ] if ( x ) else 0
+
+def report( procs, t, switches ) :
+  waits = [ w for p in procs for w in p.waits ] ; done = [ p for p in procs if ( p.finish != None and p.exits ) ]
+
+  # Jain's index over CPU time per unit weight per unit time alive, so 1 means shares proportional to weight
+
+  x = [ p.cpu / ( weight( p.nice ) * ( ( p.finish or t ) - p.arrive ) ) for p in procs if ( ( p.finish or t ) > p.arrive ) ]
+
+  return { 'time'       : t,
+           'completed'  : len( done ),
+           'throughput' : len( done ) * 1e6 / t if ( t > 0 ) else 0,
+           'utilisation': sum( p.cpu for p in procs ) / t if ( t > 0 ) else 0,
+           'fairness'   : sum( x ) ** 2 / ( len( x ) * sum( y * y for y in x ) ) if ( x and any( x ) ) else 1,
+           'wait_p50'   : percentile( waits, 0.50 ),
+           'wait_p99'   : percentile( waits, 0.99 ),
+           'wait_max'   : max( waits ) if ( waits ) else 0,
+           'switches'   : switches,
+           'nvcsw'      : sum( p.nvcsw  for p in procs ),
+           'nivcsw'     : sum( p.nivcsw for p in procs ) }
+
+# A workload is recorded by the kernel trace (see trace.h) of a run, with at
+# least switch events and, ideally, system call, fork, exit and nice events
+# enabled (i.e., via the console command trace 9b): a process arrives when it
+# is forked, and each period it executes ends a burst if it then yielded,
+# blocked (in a futex, sleep, timed read or poll, where the wait is taken to
+# last until it is next executed) or exited; otherwise it was preempted, so
+# the burst continues.  A process alive at the end of the trace stops there,
+# but does not count as completed.
+
+SVC_YIELD = 0x00 ; SVC_EXIT = 0x04 ; SVC_BLOCK = [ 0x0B, 0x0C, 0x0D, 0x1D ]
+
+def load_trace( f ) :
+  procs = {} ; base = None ; last = 0 ; wrap = 0 ; start = {} ; svc = {} ; off = {}
+
+  def proc( pid, t ) :
+    return procs.setdefault( pid, { 'pid' : pid, 'arrive' : t, 'nice' : 0, 'bursts' : [ [ 0, None ] ], 'exits' : False } )
+
+  for line in open( f, 'r' ) :
+    x = line.strip().split( ' ' )
+
+    if ( len( x ) != 6 or not x[ 0 ].startswith( '@' ) ) :
+      continue
+
+    c = int( x[ 0 ][ 1 : ], 16 )
+
+    if ( base == None ) :
+      base = c
+    if ( c < last ) :
+      wrap += 1 << 32
+
+    last = c ; t = ( c + wrap - base ) // 24 ; ev = x[ 2 ]
+
+    pid = -1 if ( x[ 3 ] == 'I' ) else int( x[ 3 ], 16 ) ; a = int( x[ 4 ], 16 ) ; b = int( x[ 5 ], 16 )
+
+    if   ( ev == 'FK' ) :
+      proc( a, t )
+    elif ( ev == 'NI' ) :
+      proc( a, t )[ 'nice' ] = b - ( 1 << 32 ) if ( b >= ( 1 << 31 ) ) else b
+    elif ( ev == 'SC' and pid >= 0 ) :
+      svc[ pid ] = a
+    elif ( ev == 'EX' and pid >= 0 ) :
+      svc[ pid ] = SVC_EXIT
+    elif ( ev == 'SW' ) :
+      nxt = -1 if ( a == 0xFFFFFFFF ) else a
+
+      if ( pid >= 0 ) :
+        p = proc( pid, t ) ; p[ 'bursts' ][ -1 ][ 0 ] += t - start.get( x[ 1 ], t ) ; s = svc.pop( pid, None )
+
+        if   ( s == SVC_EXIT ) :
+          p[ 'exits' ] = True
+        elif ( s == SVC_YIELD ) :
+          p[ 'bursts' ][ -1 ][ 1 ] = 0    ; p[ 'bursts' ].append( [ 0, None ] )
+        elif ( s in SVC_BLOCK ) :
+          p[ 'bursts' ][ -1 ][ 1 ] = True ; p[ 'bursts' ].append( [ 0, None ] ) ; off[ pid ] = t
+
+      if ( nxt >= 0 ) :
+        p = proc( nxt, t ) ; start[ x[ 1 ] ] = t
+
+        if ( nxt in off ) : # resolve the wait of a block
+          p[ 'bursts' ][ -2 ][ 1 ] = max( t - off.pop( nxt ), 1 )
+
+  for p in procs.values() :
+    for burst in p[ 'bursts' ] :
+      if ( burst[ 1 ] == True ) : # blocked at the end of the trace
+        burst[ 1 ] = None
+
+    p[ 'bursts' ] = [ burst for burst in p[ 'bursts' ] if ( burst[ 0 ] > 0 or burst[ 1 ] != None ) ] or [ [ 0, None ] ]
+
+  return sorted( procs.values(), key = lambda p : p[ 'pid' ] )
+
+# A synthetic workload mixes CPU-bound processes (such as P3 or P5), which are
+# only ever preempted, with interactive processes which execute briefly then
+# block, and processes which alternate computing and yielding.
+
+def synthetic( n, seed, tick ) :
+  rng = random.Random( seed ) ; procs = []
+
+  for pid in range( n ) :
+    kind = pid % 3 ; nice = rng.choice( [ 0, 0, 0, 5, 10 ] ) ; arrive = rng.randrange( 0, 4 * tick )
+
+    if   ( kind == 0 ) :
+      bursts = [ [ rng.randrange( 20, 60 ) * tick, None ] ]
+    elif ( kind == 1 ) :
+      bursts = [ [ rng.randrange( 1, tick // 50 ), rng.randrange( tick // 4, 2 * tick ) ] for i in range( 40 ) ] + [ [ 1, None ] ]
+    else :
+      bursts = [ [ rng.randrange( tick // 4, 2 * tick ), 0 ] for i in range( 30 ) ] + [ [ 1, None ] ]
+
+    procs.append( { 'pid' : pid, 'arrive' : arrive, 'nice' : nice, 'bursts' : bursts, 'exits' : True } )
+
+  return procs
+
+if ( __name__ == '__main__' ) :
+  # parse command line arguments
+
+  parser = argparse.ArgumentParser()
+
+  parser.add_argument( '--trace',           type =   str, action = 'store', help = 'UART0 log holding a kernel trace' )
+  parser.add_argument( '--workload',        type =   str, action = 'store', help = 'workload, as JSON' )
+  parser.add_argument( '--synthetic',       type =   int, action = 'store', default = 12, help = 'number of processes in a synthetic workload' )
+  parser.add_argument( '--save',            type =   str, action = 'store', help = 'write the workload, as JSON' )
+
+  parser.add_argument( '--policy',          type =   str, action = 'append', choices = sorted( POLICIES.keys() ) )
+  parser.add_argument( '--tick',            type =   int, action = 'store', default = TICK )
+  parser.add_argument( '--horizon',         type = float, action = 'store', default = 600, help = 'seconds' )
+  parser.add_argument( '--seed',            type =   int, action = 'store', default = 0 )
+
+  parser.add_argument( '--mlfq-levels',     type =   int, action = 'store', default = 3 )
+  parser.add_argument( '--mlfq-boost',      type =   int, action = 'store', default = 50, help = 'ticks' )
+  parser.add_argument( '--cfs-granularity', type =   int, action = 'store', default = 0, help = 'microseconds' )
+  parser.add_argument( '--cfs-latency',     type =   int, action = 'store', default = TICK, help = 'microseconds' )
+
+  parser.add_argument( '--json',                         action = 'store_true' )
+
+  args = parser.parse_args()
+
+  if   ( args.trace    != None ) :
+    workload = load_trace( args.trace )
+  elif ( args.workload != None ) :
+    workload = json.load( open( args.workload, 'r' ) )
+  else :
+    workload = synthetic( args.synthetic, args.seed, args.tick )
+
+  if ( args.save != None ) :
+    json.dump( workload, open( args.save, 'w' ), indent = 1 )
+
+  # replay the workload against each policy, then report
+
+  results = {}
+
+  for name in ( args.policy or sorted( POLICIES.keys() ) ) :
+    procs = [ Proc( p[ 'pid' ], p[ 'arrive' ], p[ 'nice' ], [ list( b ) for b in p[ 'bursts' ] ], p[ 'exits' ] ) for p in workload ]
+
+    t, switches = simulate( procs, POLICIES[ name ]( args ), args.tick, int( args.horizon * 1e6 ) )
+
+    results[ name ] = report( procs, t, switches )
+
+  if ( args.json ) :
+    json.dump( results, sys.stdout, indent = 2 ) ; print()
+  else :
+    print( '%-8s %9s %6s %8s %6s %6s %10s %10s %10s %8s %8s' % ( 'POLICY', 'TIME', 'DONE', 'TPUT/S', 'UTIL', 'FAIR', 'WAIT P50', 'WAIT P99', 'WAIT MAX', 'VCSW', 'IVCSW' ) )
+
+    for ( name, r ) in results.items() :
+      print( '%-8s %9.2f %6d %8.3f %6.3f %6.3f %10d %10d %10d %8d %8d' % ( name, r[ 'time' ] / 1e6, r[ 'completed' ], r[ 'throughput' ], r[ 'utilisation' ], r[ 'fairness' ], r[ 'wait_p50' ], r[ 'wait_p99' ], r[ 'wait_max' ], r[ 'nvcsw' ], r[ 'nivcsw' ] ) )
@@ -0,0 +1,44 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SMP_H
+#define __SMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The number of cores is fixed at build time (see PROJECT_CPUS in the
+ * Makefile): the default of 1 matches the uniprocessor realview-pb-a8,
+ * whereas the realview-pbx-a9 supports up to 4 Cortex-A9 cores.
+ */
+
+#if !defined( MAX_CPUS )
+#define MAX_CPUS 1
+#endif
+
+#if MAX_CPUS > 4
+#error "MPCore supports at most 4 cores"
+#endif
+
+// a spinlock is a single word: 0 => unlocked, 1 => locked
+typedef volatile uint32_t spinlock_t;
+
+// read the ID (0...MAX_CPUS-1) of the executing core
+extern int  cpu_id();
+
+// memory barrier: order memory accesses before and after it
+extern void mem_barrier();
+
+// acquire spinlock x, spinning (in a low-power wait) while it is held
+extern void spin_lock   ( spinlock_t* x );
+// acquire spinlock x iff. it is not held, returning true on success
+extern bool spin_trylock( spinlock_t* x );
+// release spinlock x, waking any cores spinning on it
+extern void spin_unlock ( spinlock_t* x );
+
+#endif
@@ -0,0 +1,76 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+/* The following functions support multi-core operation.  The core ID is
+ * read from the MPIDR, which only exists on MPCore variants (a Cortex-A8
+ * treats the access as undefined): MAX_CPUS is defined by the assembler
+ * command line, so a uniprocessor build just returns 0.
+ *
+ * The spinlocks use an exclusive load/store pair to atomically claim the
+ * lock word, waiting (via wfe) for a sev from the owner while it is held;
+ * the dmb instructions ensure accesses within the critical section cannot 
+ * be observed outside it.
+ */
+
+.global cpu_id
+
+.global mem_barrier
+
+.global spin_lock
+.global spin_trylock
+.global spin_unlock
+
+cpu_id:              
+.if MAX_CPUS > 1
+                     mrc   p15, 0, r0, c0, c0, 5   @ read  MPIDR
+                     and   r0, r0, #0x3            @ extract CPU ID
+.else
+                     mov   r0, #0                  @ uniprocessor => CPU ID = 0
+.endif
+                     mov   pc, lr                  @ return
+
+mem_barrier:         dmb                           @ data memory barrier
+
+                     mov   pc, lr                  @ return
+
+spin_lock:           mov   r2, #1                  @ set   locked value
+
+spin_lock_retry:     ldrex r1, [ r0 ]              @ load  lock word, marking exclusive access
+                     cmp   r1, #0                  
+                     wfene                         @ wait for event iff. lock held
+                     bne   spin_lock_retry         @ retry iff. lock held
+                     strex r1, r2, [ r0 ]          @ store lock word iff. still exclusive
+                     cmp   r1, #0                  
+                     bne   spin_lock_retry         @ retry iff. store failed
+                     dmb                           @ order critical section after acquire
+
+                     mov   pc, lr                  @ return
+
+spin_trylock:        mov   r2, #1                  @ set   locked value
+
+                     ldrex r1, [ r0 ]              @ load  lock word, marking exclusive access
+                     cmp   r1, #0                  
+                     bne   spin_trylock_fail       @ fail  iff. lock held
+                     strex r1, r2, [ r0 ]          @ store lock word iff. still exclusive
+                     cmp   r1, #0                  
+                     bne   spin_trylock_fail       @ fail  iff. store failed
+                     dmb                           @ order critical section after acquire
+
+                     mov   r0, #1                  @ return true
+                     mov   pc, lr                  
+
+spin_trylock_fail:   clrex                         @ clear exclusive access
+                     mov   r0, #0                  @ return false
+                     mov   pc, lr                  
+
+spin_unlock:         mov   r1, #0                  @ set   unlocked value
+                     dmb                           @ order critical section before release
+                     str   r1, [ r0 ]              @ store lock word
+                     dsb                           @ ensure store completes before ...
+                     sev                           @ ... waking cores waiting on it
+
+                     mov   pc, lr                  @ return
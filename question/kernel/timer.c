@@ -0,0 +1,127 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "timer.h"
+
+ktimer_t* timerWheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+uint32_t  timerTick = 0; // current tick
+int       timerNum  = 0; // number of armed timers
+
+/* Link a timer into the slot matching its expiry, wrt. the current tick: a
+ * timer beyond the range of the wheel is placed in the last slot of the top
+ * level, and so simply re-inserted there until it comes within range.
+ */
+void timer_insert( ktimer_t* x ) {
+  uint32_t at = x->expires, delta = x->expires - timerTick, level = 0;
+
+  if( delta >= ( 1 << ( WHEEL_LEVELS * WHEEL_BITS ) ) ) { 
+    delta = ( 1 << ( WHEEL_LEVELS * WHEEL_BITS ) ) - 1;
+    at    = timerTick + delta;
+  }
+
+  while( delta >= ( 1u << ( ( level + 1 ) * WHEEL_BITS ) ) ) {
+    level++;
+  }
+
+  ktimer_t** slot = &timerWheel[ level ][ ( at >> ( level * WHEEL_BITS ) ) & WHEEL_MASK ];
+
+  x->next = *slot;
+  if( x->next != NULL ) {
+    x->next->link = &x->next;
+  }
+  x->link = slot;
+  *slot   = x;
+}
+
+// Unlink a timer from whichever slot it is in
+void timer_remove( ktimer_t* x ) {
+  *x->link = x->next;
+  if( x->next != NULL ) {
+    x->next->link = x->link;
+  }
+
+  x->next = NULL;
+  x->link = NULL;
+}
+
+// Re-insert every timer in a slot, moving each one to a lower level
+void timer_cascade( int level, int index ) {
+  ktimer_t** slot = &timerWheel[ level ][ index ];
+
+  while( *slot != NULL ) {
+    ktimer_t* x = *slot;
+
+    timer_remove( x );
+    timer_insert( x );
+  }
+}
+
+void timer_init() {
+  for( int i = 0; i < WHEEL_LEVELS; i++ ) {
+    for( int j = 0; j < WHEEL_SLOTS; j++ ) {
+      timerWheel[ i ][ j ] = NULL;
+    }
+  }
+
+  timerNum = 0;
+}
+
+void timer_arm( ktimer_t* x, uint32_t n ) {
+  timer_cancel( x );
+
+  x->expires = timerTick + ( ( n > 0 ) ? n : 1 );
+  timer_insert( x );
+
+  timerNum++;
+}
+
+bool timer_cancel( ktimer_t* x ) {
+  if( x->link == NULL ) {
+    return false;
+  }
+
+  timer_remove( x );
+  timerNum--;
+
+  return true;
+}
+
+int timer_tick() {
+  int n = 0;
+
+  timerTick++;
+
+  // cascade each level that the level below has just wrapped around
+  for( int level = WHEEL_LEVELS - 1; level > 0; level-- ) {
+    if( ( timerTick & ( ( 1 << ( level * WHEEL_BITS ) ) - 1 ) ) == 0 ) {
+      timer_cascade( level, ( timerTick >> ( level * WHEEL_BITS ) ) & WHEEL_MASK );
+    }
+  }
+
+  // expire each timer in the current slot, one at a time since fn may arm or cancel others
+  ktimer_t** slot = &timerWheel[ 0 ][ timerTick & WHEEL_MASK ];
+
+  while( *slot != NULL ) {
+    ktimer_t* x = *slot;
+
+    timer_remove( x );
+    timerNum--; n++;
+
+    x->fn( x );
+  }
+
+  return n;
+}
+
+int timer_pending() {
+  return timerNum;
+}
+
+uint32_t timer_now() {
+  return timerTick;
+}
@@ -0,0 +1,60 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __TIMER_H
+#define __TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A hierarchical timer wheel, advanced by one tick every 1/TIMER_HZ sec.
+ * Each level has WHEEL_SLOTS slots, and each slot a list of timers: the 
+ * first level has a slot per tick, and each subsequent level a slot per
+ * WHEEL_SLOTS slots of the previous one.  Once a level wraps around, the 
+ * next slot of the level above is cascaded (re-inserted) into it.  Arming, 
+ * cancelling and advancing are therefore all O(1) (amortised), however 
+ * many timers are armed.
+ *
+ * The wheel performs no locking: callers must serialise access to it.
+ */
+
+#define TIMER_HZ     1000 // must divide 1000
+
+#define TIMER_MS_TO_TICKS( x ) ( ( x ) / ( 1000 / TIMER_HZ ) )
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  ( 1 << WHEEL_BITS )
+#define WHEEL_MASK   ( WHEEL_SLOTS - 1 )
+
+#define TIMEOUT_INFINITE 0xFFFFFFFF
+
+typedef struct ktimer {
+        uint32_t  expires; // tick at which the timer expires
+  struct ktimer*     next; // next timer in same slot, NULL if last
+  struct ktimer**    link; // pointer to this timer in its slot, NULL if not armed
+  void ( *fn )( struct ktimer* x ); // function invoked on expiry
+} ktimer_t;
+
+// initialise (i.e., empty) the wheel
+extern void     timer_init();
+
+// arm timer x to expire after n ticks (at least 1), cancelling it first if armed
+extern void     timer_arm( ktimer_t* x, uint32_t n );
+// cancel timer x, returning true iff. it was armed
+extern bool     timer_cancel( ktimer_t* x );
+
+// advance the wheel by one tick, invoking expired timers; return the number expired
+extern int      timer_tick();
+
+// number of armed timers
+extern int      timer_pending();
+// current tick
+extern uint32_t timer_now();
+
+#endif
@@ -0,0 +1,171 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "trace.h"
+
+trace_ring_t traceRing[ MAX_CPUS ];
+uint32_t     traceMask = TRACE_DEFAULT;
+
+spinlock_t   traceLock = 0;    // held by whichever CPU is draining
+
+uint32_t     traceLost[ MAX_CPUS ]; // dropped events already reported, per ring
+
+char         traceLine[ 40 ];  // event being drained, as text
+int          traceLineLen = 0;
+int          traceLinePos = 0;
+
+const char*  traceName[ TRACE_EVENTS ] = { "SW", "SC", "IR", "FK", "EX", "EC", "KL", "NI", "PR", "PW" };
+
+void trace_init() {
+  for( int i = 0; i < MAX_CPUS; i++ ) {
+    traceRing[ i ].head = 0;
+    traceRing[ i ].tail = 0;
+    traceRing[ i ].lost = 0;
+    traceLost[ i ]      = 0;
+  }
+}
+
+void trace( trace_type_t x, int pid, uint32_t a, uint32_t b ) {
+  if( !( traceMask & ( 1 << x ) ) ) {
+    return;
+  }
+
+  uint32_t      cpsr = int_save_irq();
+
+  trace_ring_t* ring = &traceRing[ cpu_id() ];
+  uint32_t      head = ring->head;
+
+  if( ( head - ring->tail ) >= TRACE_SIZE ) {
+    ring->lost++; int_restore_irq( cpsr ); return;
+  }
+
+  trace_event_t* e = &ring->buf[ head & ( TRACE_SIZE - 1 ) ];
+
+  e->time = SYSCONF->COUNTER_24MHZ;
+  e->type = x;
+  e->cpu  = cpu_id();
+  e->pid  = pid;
+  e->a    = a;
+  e->b    = b;
+
+  mem_barrier(); // publish event before advancing head
+
+  ring->head = head + 1;
+
+  int_restore_irq( cpsr );
+}
+
+// append x to the line as n hexadecimal digits
+void trace_hex( uint32_t x, int n ) {
+  for( int i = n - 1; i >= 0; i-- ) {
+    traceLine[ traceLineLen++ ] = itox( ( x >> ( 4 * i ) ) & 0xF );
+  }
+}
+
+// format event e as a line
+void trace_format( trace_event_t* e ) {
+  traceLineLen = 0; traceLinePos = 0;
+
+  traceLine[ traceLineLen++ ] = '@';
+  trace_hex( e->time, 8 );
+  traceLine[ traceLineLen++ ] = ' ';
+  traceLine[ traceLineLen++ ] = '0' + e->cpu;
+  traceLine[ traceLineLen++ ] = ' ';
+  traceLine[ traceLineLen++ ] = traceName[ e->type ][ 0 ];
+  traceLine[ traceLineLen++ ] = traceName[ e->type ][ 1 ];
+  traceLine[ traceLineLen++ ] = ' ';
+
+  if( e->pid < 0 ) {
+    traceLine[ traceLineLen++ ] = 'I';
+  }
+  else {
+    trace_hex( e->pid, 2 );
+  }
+
+  traceLine[ traceLineLen++ ] = ' ';
+  trace_hex( e->a, 8 );
+  traceLine[ traceLineLen++ ] = ' ';
+  trace_hex( e->b, 8 );
+  traceLine[ traceLineLen++ ] = '\n';
+}
+
+// format a note that n events were dropped as a line
+void trace_format_lost( int cpu, uint32_t n ) {
+  traceLineLen = 0; traceLinePos = 0;
+
+  traceLine[ traceLineLen++ ] = '!';
+  traceLine[ traceLineLen++ ] = '0' + cpu;
+  traceLine[ traceLineLen++ ] = ' ';
+  trace_hex( n, 8 );
+  traceLine[ traceLineLen++ ] = '\n';
+}
+
+// transmit the rest of the line, returning false iff. the UART would block
+bool trace_flush( bool f ) {
+  while( traceLinePos < traceLineLen ) {
+    if( !f && !PL011_can_putc( UART0 ) ) {
+      return false;
+    }
+
+    PL011_putc( UART0, traceLine[ traceLinePos++ ], true );
+  }
+
+  return true;
+}
+
+/* Events are drained in time order, by selecting the ring whose oldest
+ * event is earliest; a signed difference allows for wrap-around of the
+ * counter.
+ */
+
+int trace_drain( int n, bool f ) {
+  int r = 0;
+
+  if( !spin_trylock( &traceLock ) ) { // another CPU is already draining
+    return 0;
+  }
+
+  while( trace_flush( f ) && ( r < n ) ) {
+    trace_ring_t* ring = NULL; bool lost = false;
+
+    for( int i = 0; i < MAX_CPUS; i++ ) {
+      trace_ring_t* t = &traceRing[ i ];
+
+      if( t->lost != traceLost[ i ] ) { // report dropped events first
+        trace_format_lost( i, t->lost - traceLost[ i ] ); traceLost[ i ] = t->lost; lost = true; break;
+      }
+      if( t->tail == t->head ) {
+        continue;
+      }
+
+      mem_barrier(); // read event only after observing head
+
+      if( ( ring == NULL ) || ( ( int32_t )( t->buf[ t->tail & ( TRACE_SIZE - 1 ) ].time - ring->buf[ ring->tail & ( TRACE_SIZE - 1 ) ].time ) < 0 ) ) {
+        ring = t;
+      }
+    }
+
+    if( lost ) {
+      continue;
+    }
+    if( ring == NULL ) { // nothing left to drain
+      break;
+    }
+
+    trace_format( &ring->buf[ ring->tail & ( TRACE_SIZE - 1 ) ] );
+
+    mem_barrier(); // consume event before advancing tail
+
+    ring->tail++; r++;
+  }
+
+  trace_flush( f );
+
+  spin_unlock( &traceLock );
+
+  return r;
+}
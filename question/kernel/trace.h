@@ -0,0 +1,94 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PL011.h"
+#include   "SYS.h"
+
+#include   "int.h"
+#include   "smp.h"
+
+/* Kernel events are recorded in a binary trace buffer, rather than printed
+ * synchronously: recording an event costs a few stores, whereas printing
+ * it costs a wait for the UART per character.
+ *
+ * Each CPU has its own ring buffer, which only it writes to (with IRQ
+ * interrupts disabled, since handlers may nest) so recording needs no
+ * lock: the writer advances head only after the event is complete, and the
+ * reader advances tail only after it has consumed the event.  If a ring is
+ * full the event is dropped and counted, so the reader never races the
+ * writer.
+ *
+ * The rings are drained to UART0 lazily, i.e., a few events at a time (by
+ * a bottom half raised on each scheduler tick, or when a CPU goes idle)
+ * without ever waiting for the UART, or completely on demand.  Each event
+ * is printed as a line
+ *
+ * @TTTTTTTT C EV PID A B
+ *
+ * i.e., the 24MHz counter, CPU ID, event type, PID ('I' for idle), and two
+ * event-specific arguments (in hexadecimal).
+ */
+
+#define TRACE_SIZE   ( 256 ) // events per ring, which must be a power of 2
+#define TRACE_BUDGET (  16 ) // events per lazy drain
+
+typedef enum {
+  TRACE_SWITCH,  // context switch:   pid -> a
+  TRACE_SVC,     // system call:      a = ID,  b = r0 (if it has arguments)
+  TRACE_IRQ,     // interrupt:        a = ID,  b = 1 iff. nested
+  TRACE_FORK,    // fork:             a = child PID
+  TRACE_EXIT,    // exit:             a = status
+  TRACE_EXEC,    // exec:             a = entry point
+  TRACE_KILL,    // kill:             a = PID, b = signal
+  TRACE_NICE,    // nice:             a = PID, b = niceness
+  TRACE_PIPE_RD, // read  from pipe:  a = fd,  b = bytes read
+  TRACE_PIPE_WR, // write to   pipe:  a = fd,  b = bytes written
+  TRACE_EVENTS
+} trace_type_t;
+
+// events recorded by default, i.e., those previously printed synchronously
+#define TRACE_DEFAULT ( ( 1 << TRACE_SWITCH ) | ( 1 << TRACE_FORK ) | \
+                        ( 1 << TRACE_EXIT   ) | ( 1 << TRACE_EXEC ) | \
+                        ( 1 << TRACE_KILL   ) | ( 1 << TRACE_NICE ) )
+
+typedef struct {
+  uint32_t time; // 24MHz counter
+  uint8_t  type; // trace_type_t
+  uint8_t   cpu;
+  int16_t   pid;
+  uint32_t    a;
+  uint32_t    b;
+} trace_event_t;
+
+typedef struct {
+  volatile uint32_t head; // next event to write (by owning CPU only)
+  volatile uint32_t tail; // next event to read  (by drain only)
+  volatile uint32_t lost; // events dropped, since ring was full (by owning CPU only)
+  trace_event_t buf[ TRACE_SIZE ];
+} trace_ring_t;
+
+// operations of trace system call
+#define TRACE_OP_MASK ( 0 )
+#define TRACE_OP_DUMP ( 1 )
+
+extern uint32_t traceMask;
+
+// initialise trace buffer
+extern void     trace_init();
+// record event of type x for process pid, with arguments a and b
+extern void     trace( trace_type_t x, int pid, uint32_t a, uint32_t b );
+// drain up to n events to UART0, waiting for the UART iff. f = true; return events drained
+extern int      trace_drain( int n, bool f );
+
+#endif
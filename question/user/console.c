@@ -38,6 +38,8 @@ extern void main_P3();
 extern void main_P4(); 
 extern void main_P5(); 
 extern void main_philosophers();
+extern void main_memops_bench();
+extern void main_sysbench();
 
 void* load( char* x ) {
   if     ( 0 == strcmp( x, "P3" ) ) {
@@ -52,10 +54,144 @@ void* load( char* x ) {
   else if( 0 == strcmp( x, "Ph" ) ) {
     return &main_philosophers;
   }
+  else if( 0 == strcmp( x, "Mb" ) ) {
+    return &main_memops_bench;
+  }
+  else if( 0 == strcmp( x, "Sb" ) ) {
+    return &main_sysbench;
+  }
 
   return NULL;
 }
 
+/* The following functions support the top command: they write an integer
+ * right-aligned in a field of n characters, and convert 24MHz counter
+ * cycles into milliseconds.
+ */
+
+void putn( int x, int n ) {
+  char t[ 12 ]; itoa( t, x ); int m = strlen( t );
+
+  for( int i = m; i < n; i++ ) {
+    puts( " ", 1 );
+  }
+
+  puts( t, m );
+}
+
+int  cycles_ms( uint64_t x ) {
+  return ( int )( x / ( vdso.freq / 1000 ) );
+}
+
+void top( char* x ) {
+  proc_stats_t s;
+
+  if( x != NULL ) {
+    if( proc_stats( atoi( x ), &s ) < 0 ) {
+      puts( "unknown process\n", 16 ); return;
+    }
+
+    puts( "  SVC   CALLS\n", 14 );
+
+    for( int i = 0; i < MAX_SVCS; i++ ) {
+      if( s.svcCount[ i ] != 0 ) {
+        putn( i, 5 ); putn( s.svcCount[ i ], 8 ); puts( "\n", 1 );
+      }
+    }
+
+    return;
+  }
+
+  puts( "  PID S  USER(ms)   SYS(ms)   IRQ(ms)   VCSW  IVCSW  WAKE(us)\n", 62 );
+
+  for( pid_t i = -MAX_CPUS; i < MAX_PROCS; i++ ) {
+    int r = proc_stats( i, &s );
+
+    if( r < 0 || r == PROC_TERMINATED ) {
+      continue;
+    }
+
+    putn( i, 5 ); puts( " ", 1 ); puts( &"?CTRXW"[ r ], 1 );
+    putn( cycles_ms( s.userCycles   ), 10 );
+    putn( cycles_ms( s.kernelCycles ), 10 );
+    putn( cycles_ms( s.irqCycles    ), 10 );
+    putn( s.nvcsw,  7 );
+    putn( s.nivcsw, 7 );
+    putn( s.wakeMax / ( vdso.freq / 1000000 ), 10 ); puts( "\n", 1 );
+  }
+}
+
+/* The latency of each system call is kept as a histogram whose i-th bucket
+ * counts calls which took [2^i, 2^(i+1)) cycles, so a percentile is given
+ * as the upper bound of the bucket that contains it.
+ */
+
+int  percentile( uint32_t* x, int n, int p ) {
+  int m = ( ( n * p ) + 99 ) / 100;
+
+  for( int i = 0; i < SVC_HIST_BUCKETS; i++ ) {
+    if( ( m -= x[ i ] ) <= 0 ) {
+      return 2 << i;
+    }
+  }
+
+  return 2 << ( SVC_HIST_BUCKETS - 1 );
+}
+
+void latency( char* x ) {
+  uint32_t h[ SVC_HIST_BUCKETS ];
+
+  if( x != NULL ) {
+    if( svc_stats( atoi( x ), h ) < 0 ) {
+      puts( "unknown system call\n", 20 ); return;
+    }
+
+    puts( "   CYCLES >=     CALLS\n", 23 );
+
+    for( int i = 0; i < SVC_HIST_BUCKETS; i++ ) {
+      if( h[ i ] != 0 ) {
+        putn( 1 << i, 12 ); putn( h[ i ], 10 ); puts( "\n", 1 );
+      }
+    }
+
+    return;
+  }
+
+  puts( "  SVC     CALLS       P50       P99\n", 35 );
+
+  for( int i = 0; i < MAX_SVCS; i++ ) {
+    int n = svc_stats( i, h );
+
+    if( n > 0 ) {
+      putn( i, 5 ); putn( n, 10 );
+      putn( percentile( h, n, 50 ), 10 );
+      putn( percentile( h, n, 99 ), 10 ); puts( "\n", 1 );
+    }
+  }
+}
+
+// list each process group which has a quota or processes in it, with its quota and usage to date
+
+void group_list() {
+  group_stats_t s;
+
+  puts( "  GID  PROCS QUOTA(ms) PERIOD(ms)   USED(ms) THROTTLES\n", 54 );
+
+  for( int i = 0; i < MAX_GROUPS; i++ ) {
+    int n = group_stats( i, &s );
+
+    if( n <= 0 && s.quota == 0 ) {
+      continue;
+    }
+
+    putn( i, 5 ); putn( n, 7 );
+    putn( s.quota,  10 );
+    putn( s.period, 11 );
+    putn( cycles_ms( s.usedCycles ), 11 );
+    putn( s.throttles, 10 ); puts( s.throttled ? " *\n" : "\n", s.throttled ? 3 : 1 );
+  }
+}
+
 /* The behaviour of a console process can be summarised as an infinite 
  * loop over three main steps, namely
  *
@@ -65,12 +201,14 @@ void* load( char* x ) {
  *
  * As is, the console only recognises the following commands:
  *
- * a. execute <program name>
+ * a. execute <program name> [group ID]
  *
  *    This command will use fork to create a new process; the parent
  *    (i.e., the console) will continue as normal, whereas the child
  *    uses exec to replace the process image and thereby execute a
- *    different (named) program.  For example,
+ *    different (named) program.  If a group is provided, the child
+ *    first joins it (so any process it forks is also in it).  For
+ *    example,
  *    
  *    execute P3
  *
@@ -86,6 +224,66 @@ void* load( char* x ) {
  *    terminate 3
  *
  *    would terminate the process whose PID is 3.
+ *
+ * c. trace <event mask> | trace [dump]
+ *
+ *    The kernel records events (e.g., context switches) in a trace
+ *    buffer.  This command either selects which events are recorded,
+ *    per the bits of a hexadecimal mask (where 0 disables tracing),
+ *    or prints all recorded events (rather than waiting for them to
+ *    be printed as and when the kernel is otherwise idle).  For
+ *    example,
+ *
+ *    trace 7
+ *
+ *    would record context switches, system calls and interrupts.
+ *
+ * d. top [process ID]
+ *
+ *    This command lists the resource usage of each process (plus an
+ *    idle process per CPU, shown with a negative PID) to date: time
+ *    (in milliseconds) spent in user mode, system calls and interrupt
+ *    handlers, voluntary and involuntary context switches, and the
+ *    maximum latency (in microseconds) from being woken to executing.
+ *    If a PID is provided, it instead lists how many times that process
+ *    made each system call.
+ *
+ * e. latency [system call ID]
+ *
+ *    This command lists, for each system call made so far, how many
+ *    times it has been made and the (approximate) median and 99-th
+ *    percentile latency in 24MHz counter cycles.  If an ID is given,
+ *    it instead prints the latency histogram of that system call.
+ *
+ * f. profile <period> | profile stop | profile dump | profile disk
+ *
+ *    This command controls a sampling profiler: it either starts the
+ *    profiler, taking a sample every period microseconds, stops it,
+ *    or stops it then dumps the samples to the terminal or the disk
+ *    (for analysis via kernel/profile.py).  For example,
+ *
+ *    profile 1000
+ *
+ *    would sample the executing process every millisecond.
+ *
+ * g. group <process ID> <group ID>
+ *
+ *    This command moves a process into a process group (0 being the
+ *    default, of which the console is a member).
+ *
+ * h. quota <group ID> <quota> <period> | quota
+ *
+ *    This command limits the processes in a group (other than 0) to,
+ *    in total, quota milliseconds of CPU time per period milliseconds,
+ *    or removes the limit iff. quota is 0.  Without arguments it lists
+ *    the quota and usage of each group, marking any which has used up
+ *    its quota in the current period.  For example,
+ *
+ *    quota 1 250 1000
+ *    execute Ph 1
+ *
+ *    would run the dining philosophers (all of which are forked into
+ *    group 1) on at most a quarter of a CPU.
  */
 
 void main_console() {
@@ -111,6 +309,10 @@ void main_console() {
 
       if( addr != NULL ) {
         if( 0 == fork() ) {
+          if( cmd_argc > 2 ) {
+            group_join( getpid(), atoi( cmd_argv[ 2 ] ) );
+          }
+
           exec( addr );
         }
       }
@@ -121,6 +323,57 @@ void main_console() {
     else if( 0 == strcmp( cmd_argv[ 0 ], "terminate" ) ) {
       kill( atoi( cmd_argv[ 1 ] ), SIG_TERM );
     } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "trace"     ) ) {
+      if( ( cmd_argc < 2 ) || ( 0 == strcmp( cmd_argv[ 1 ], "dump" ) ) ) {
+        ktrace( TRACE_OP_DUMP, 0 );
+      }
+      else {
+        uint32_t mask = 0;
+
+        for( char* t = cmd_argv[ 1 ]; *t != '\x00'; t++ ) {
+          mask = ( mask << 4 ) | xtoi( *t );
+        }
+
+        ktrace( TRACE_OP_MASK, mask );
+      }
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "top"       ) ) {
+      top( ( cmd_argc > 1 ) ? cmd_argv[ 1 ] : NULL );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "latency"   ) ) {
+      latency( ( cmd_argc > 1 ) ? cmd_argv[ 1 ] : NULL );
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "profile"   ) && ( cmd_argc > 1 ) ) {
+      if     ( 0 == strcmp( cmd_argv[ 1 ], "stop" ) ) {
+        profile( PROFILE_OP_STOP, 0 );
+      }
+      else if( 0 == strcmp( cmd_argv[ 1 ], "dump" ) ) {
+        profile( PROFILE_OP_DUMP, 0 );
+      }
+      else if( 0 == strcmp( cmd_argv[ 1 ], "disk" ) ) {
+        if( profile( PROFILE_OP_DISK, 0 ) < 0 ) {
+          puts( "disk error\n", 11 );
+        }
+      }
+      else {
+        profile( PROFILE_OP_START, atoi( cmd_argv[ 1 ] ) );
+      }
+    } 
+    else if( 0 == strcmp( cmd_argv[ 0 ], "group"     ) && ( cmd_argc > 2 ) ) {
+      if( group_join( atoi( cmd_argv[ 1 ] ), atoi( cmd_argv[ 2 ] ) ) < 0 ) {
+        puts( "invalid process or group\n", 25 );
+      }
+    }
+    else if( 0 == strcmp( cmd_argv[ 0 ], "quota"     ) ) {
+      if( cmd_argc > 3 ) {
+        if( group_quota( atoi( cmd_argv[ 1 ] ), atoi( cmd_argv[ 2 ] ), atoi( cmd_argv[ 3 ] ) ) < 0 ) {
+          puts( "invalid group or quota\n", 23 );
+        }
+      }
+      else {
+        group_list();
+      }
+    }
     else {
       puts( "unknown command\n", 16 );
     }
@@ -21,4 +21,9 @@
 #define MAX_CMD_CHARS ( 1024 )
 #define MAX_CMD_ARGS  (    2 )
 
+#ifndef MAX_CPUS // number of CPUs (i.e., idle processes listed by top), per Makefile
+#define MAX_CPUS      (    1 )
+#endif
+#define MAX_PROCS     (  100 )
+
 #endif
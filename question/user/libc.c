@@ -7,6 +7,8 @@
 
 #include "libc.h"
 
+#include <string.h>
+
 int  atoi( char* x        ) {
   char* p = x; bool s = false; int r = 0;
 
@@ -53,10 +55,11 @@ void itoa( char* r, int x ) {
 }
 
 void yield() {
-  asm volatile( "svc %0     \n" // make system call SYS_YIELD
+  asm volatile( "mov r7, %0 \n" // assign r7 = SYS_YIELD
+                "svc #0     \n" // make system call
               :
               : "I" (SYS_YIELD)
-              : );
+              : "r7" );
 
   return;
 }
@@ -67,11 +70,12 @@ int write( int fd, const void* x, size_t n ) {
   asm volatile( "mov r0, %2 \n" // assign r0 = fd
                 "mov r1, %3 \n" // assign r1 =  x
                 "mov r2, %4 \n" // assign r2 =  n
-                "svc %1     \n" // make system call SYS_WRITE
+                "mov r7, %1 \n" // assign r7 = SYS_WRITE
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r  = r0
               : "=r" (r) 
               : "I" (SYS_WRITE), "r" (fd), "r" (x), "r" (n)
-              : "r0", "r1", "r2" );
+              : "r0", "r1", "r2", "r7" );
 
   return r;
 }
@@ -82,11 +86,94 @@ int  read( int fd,       void* x, size_t n ) {
   asm volatile( "mov r0, %2 \n" // assign r0 = fd
                 "mov r1, %3 \n" // assign r1 =  x
                 "mov r2, %4 \n" // assign r2 =  n
-                "svc %1     \n" // make system call SYS_READ
+                "mov r7, %1 \n" // assign r7 = SYS_READ
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r  = r0
               : "=r" (r) 
               : "I" (SYS_READ),  "r" (fd), "r" (x), "r" (n) 
-              : "r0", "r1", "r2" );
+              : "r0", "r1", "r2", "r7" );
+
+  return r;
+}
+
+int writev( int fd, const struct iovec* iov, int iovcnt ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 = iov
+                "mov r2, %4 \n" // assign r2 = iovcnt
+                "mov r7, %1 \n" // assign r7 = SYS_WRITEV
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_WRITEV), "r" (fd), "r" (iov), "r" (iovcnt)
+              : "r0", "r1", "r2", "memory", "r7" );
+
+  return r;
+}
+
+int  readv( int fd, const struct iovec* iov, int iovcnt ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 = iov
+                "mov r2, %4 \n" // assign r2 = iovcnt
+                "mov r7, %1 \n" // assign r7 = SYS_READV
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_READV),  "r" (fd), "r" (iov), "r" (iovcnt)
+              : "r0", "r1", "r2", "memory", "r7" );
+
+  return r;
+}
+
+int pwrite( int fd, const void* x, size_t n, int32_t off ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 =  x
+                "mov r2, %4 \n" // assign r2 =  n
+                "mov r3, %5 \n" // assign r3 = off
+                "mov r7, %1 \n" // assign r7 = SYS_PWRITE
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_PWRITE), "r" (fd), "r" (x), "r" (n), "r" (off)
+              : "r0", "r1", "r2", "r3", "r7" );
+
+  return r;
+}
+
+int  pread( int fd,       void* x, size_t n, int32_t off ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 =  x
+                "mov r2, %4 \n" // assign r2 =  n
+                "mov r3, %5 \n" // assign r3 = off
+                "mov r7, %1 \n" // assign r7 = SYS_PREAD
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_PREAD),  "r" (fd), "r" (x), "r" (n), "r" (off)
+              : "r0", "r1", "r2", "r3", "memory", "r7" );
+
+  return r;
+}
+
+int   poll( struct pollfd* fds, int nfds, int ms ) {
+  int r; uint32_t t = ( ms < 0 ) ? TIMEOUT_INFINITE : ( uint32_t )( ms );
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fds
+                "mov r1, %3 \n" // assign r1 = nfds
+                "mov r2, %4 \n" // assign r2 = t
+                "mov r7, %1 \n" // assign r7 = SYS_POLL
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_POLL), "r" (fds), "r" (nfds), "r" (t)
+              : "r0", "r1", "r2", "memory", "r7" );
 
   return r;
 }
@@ -94,31 +181,38 @@ int  read( int fd,       void* x, size_t n ) {
 int  fork() {
   int r;
 
-  asm volatile( "svc %1     \n" // make system call SYS_FORK
+  asm volatile( "mov r7, %1 \n" // assign r7 = SYS_FORK
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r  = r0 
               : "=r" (r) 
               : "I" (SYS_FORK)
-              : "r0" );
+              : "r0", "r7" );
 
   return r;
 }
 
+extern void stdio_exit();
+
 void exit( int x ) {
+  stdio_exit();
+
   asm volatile( "mov r0, %1 \n" // assign r0 =  x
-                "svc %0     \n" // make system call SYS_EXIT
+                "mov r7, %0 \n" // assign r7 = SYS_EXIT
+                "svc #0     \n" // make system call
               :
               : "I" (SYS_EXIT), "r" (x)
-              : "r0" );
+              : "r0", "r7" );
 
   return;
 }
 
 void exec( const void* x ) {
   asm volatile( "mov r0, %1 \n" // assign r0 = x
-                "svc %0     \n" // make system call SYS_EXEC
+                "mov r7, %0 \n" // assign r7 = SYS_EXEC
+                "svc #0     \n" // make system call
               :
               : "I" (SYS_EXEC), "r" (x)
-              : "r0" );
+              : "r0", "r7" );
 
   return;
 }
@@ -128,11 +222,12 @@ int  kill( int pid, int x ) {
 
   asm volatile( "mov r0, %2 \n" // assign r0 =  pid
                 "mov r1, %3 \n" // assign r1 =    x
-                "svc %1     \n" // make system call SYS_KILL
+                "mov r7, %1 \n" // assign r7 = SYS_KILL
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r0 =    r
               : "=r" (r) 
               : "I" (SYS_KILL), "r" (pid), "r" (x)
-              : "r0", "r1" );
+              : "r0", "r1", "r7" );
 
   return r;
 }
@@ -140,23 +235,87 @@ int  kill( int pid, int x ) {
 void nice( int pid, int x ) {
   asm volatile( "mov r0, %1 \n" // assign r0 =  pid
                 "mov r1, %2 \n" // assign r1 =    x
-                "svc %0     \n" // make system call SYS_NICE
+                "mov r7, %0 \n" // assign r7 = SYS_NICE
+                "svc #0     \n" // make system call
               : 
               : "I" (SYS_NICE), "r" (pid), "r" (x)
-              : "r0", "r1" );
+              : "r0", "r1", "r7" );
 
   return;
 }
 
+int  sched_setscheduler( pid_t pid, int policy, int priority ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =      pid
+                "mov r1, %3 \n" // assign r1 =   policy
+                "mov r2, %4 \n" // assign r2 = priority
+                "mov r7, %1 \n" // assign r7 = SYS_SCHED_SETSCHEDULER
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =       r0
+              : "=r" (r) 
+              : "I" (SYS_SCHED_SETSCHEDULER), "r" (pid), "r" (policy), "r" (priority)
+              : "r0", "r1", "r2", "r7" );
+
+  return r;
+}
+
+int  group_join( pid_t pid, int gid ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = pid
+                "mov r1, %3 \n" // assign r1 = gid
+                "mov r7, %1 \n" // assign r7 = SYS_GROUP_JOIN
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_GROUP_JOIN), "r" (pid), "r" (gid)
+              : "r0", "r1", "r7" );
+
+  return r;
+}
+
+int  group_quota( int gid, uint32_t quota, uint32_t period ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 =    gid
+                "mov r1, %3 \n" // assign r1 =  quota
+                "mov r2, %4 \n" // assign r2 = period
+                "mov r7, %1 \n" // assign r7 = SYS_GROUP_QUOTA
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =     r0
+              : "=r" (r) 
+              : "I" (SYS_GROUP_QUOTA), "r" (gid), "r" (quota), "r" (period)
+              : "r0", "r1", "r2", "r7" );
+
+  return r;
+}
+
+int  group_stats( int gid, group_stats_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = gid
+                "mov r1, %3 \n" // assign r1 =   x
+                "mov r7, %1 \n" // assign r7 = SYS_GROUP_STATS
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_GROUP_STATS), "r" (gid), "r" (x)
+              : "r0", "r1", "memory", "r7" );
+
+  return r;
+}
+
 int pipe(int pipedes[2]) {
   int r;
 
   asm volatile( "mov r0, %2 \n" // assign r0 = pipedes
-                "svc %1     \n" // make system call SYS_PIPE
+                "mov r7, %1 \n" // assign r7 = SYS_PIPE
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r0 = r
               : "=r" (r)
               : "I" (SYS_PIPE), "r" (pipedes)
-              : "r0" );
+              : "r0", "r7" );
 
   return r;
 }
@@ -165,20 +324,840 @@ int close(int fd) {
   int r;
 
   asm volatile( "mov r0, %2 \n" // assign r0 = fd
-                "svc %1     \n" // make system call SYS_CLOSE
+                "mov r7, %1 \n" // assign r7 = SYS_CLOSE
+                "svc #0     \n" // make system call
                 "mov %0, r0 \n" // assign r0 = r
               : "=r" (r)
               : "I" (SYS_CLOSE), "r" (fd)
-              : "r0" );
+              : "r0", "r7" );
 
   return r;
 }
 
 void print_fds() {
-  asm volatile( "svc %0     \n" // make system call SYS_PRINT_FDS
+  asm volatile( "mov r7, %0 \n" // assign r7 = SYS_PRINT_FDS
+                "svc #0     \n" // make system call
               :
               : "I" (SYS_PRINT_FDS)
-              : );
+              : "r7" );
+
+  return;
+}
+
+int futex( volatile int* addr, int op, int x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                "mov r1, %3 \n" // assign r1 =   op
+                "mov r2, %4 \n" // assign r2 =    x
+                "mov r7, %1 \n" // assign r7 = SYS_FUTEX
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =   r0
+              : "=r" (r)
+              : "I" (SYS_FUTEX), "r" (addr), "r" (op), "r" (x)
+              : "r0", "r1", "r2", "memory", "r7" );
+
+  return r;
+}
+
+int futex_timed( volatile int* addr, int x, uint32_t ms ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                "mov r1, %3 \n" // assign r1 =   op
+                "mov r2, %4 \n" // assign r2 =    x
+                "mov r3, %5 \n" // assign r3 =   ms
+                "mov r7, %1 \n" // assign r7 = SYS_FUTEX
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =   r0
+              : "=r" (r)
+              : "I" (SYS_FUTEX), "r" (addr), "r" (FUTEX_WAIT_TIMED), "r" (x), "r" (ms)
+              : "r0", "r1", "r2", "r3", "memory", "r7" );
+
+  return r;
+}
+
+void sleep_ms( uint32_t ms ) {
+  asm volatile( "mov r0, %1 \n" // assign r0 =   ms
+                "mov r7, %0 \n" // assign r7 = SYS_SLEEP
+                "svc #0     \n" // make system call
+              :
+              : "I" (SYS_SLEEP), "r" (ms)
+              : "r0", "r7" );
 
   return;
 }
+
+int  nanosleep( const struct timespec* req, struct timespec* rem ) {
+  uint32_t ms = ( req->tv_sec * 1000 ) + ( ( req->tv_nsec + 999999 ) / 1000000 );
+
+  sleep_ms( ms );
+
+  if( rem != NULL ) {
+    rem->tv_sec  = 0;
+    rem->tv_nsec = 0;
+  }
+
+  return 0;
+}
+
+int  read_timed( int fd, void* x, size_t n, uint32_t ms ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                "mov r1, %3 \n" // assign r1 =  x
+                "mov r2, %4 \n" // assign r2 =  n
+                "mov r3, %5 \n" // assign r3 = ms
+                "mov r7, %1 \n" // assign r7 = SYS_READ_TIMED
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_READ_TIMED), "r" (fd), "r" (x), "r" (n), "r" (ms)
+              : "r0", "r1", "r2", "r3", "memory", "r7" );
+
+  return r;
+}
+
+int  proc_stats( pid_t pid, proc_stats_t* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = pid
+                "mov r1, %3 \n" // assign r1 =   x
+                "mov r7, %1 \n" // assign r7 = SYS_PROC_STATS
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_PROC_STATS), "r" (pid), "r" (x)
+              : "r0", "r1", "memory", "r7" );
+
+  return r;
+}
+
+int  svc_stats( int svc, uint32_t x[ SVC_HIST_BUCKETS ] ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = svc
+                "mov r1, %3 \n" // assign r1 =   x
+                "mov r7, %1 \n" // assign r7 = SYS_SVC_STATS
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  =  r0
+              : "=r" (r) 
+              : "I" (SYS_SVC_STATS), "r" (svc), "r" (x)
+              : "r0", "r1", "memory", "r7" );
+
+  return r;
+}
+
+int  profile( int op, uint32_t x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = op
+                "mov r1, %3 \n" // assign r1 =  x
+                "mov r7, %1 \n" // assign r7 = SYS_PROFILE
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_PROFILE), "r" (op), "r" (x)
+              : "r0", "r1", "r7" );
+
+  return r;
+}
+
+uint32_t ktrace( int op, uint32_t x ) {
+  uint32_t r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = op
+                "mov r1, %3 \n" // assign r1 =  x
+                "mov r7, %1 \n" // assign r7 = SYS_TRACE
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_TRACE), "r" (op), "r" (x)
+              : "r0", "r1", "r7" );
+
+  return r;
+}
+
+pid_t getpid() {
+  pid_t r;
+
+  asm volatile( "mov r7, %1 \n" // assign r7 = SYS_GETPID
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_GETPID)
+              : "r0", "r1", "r7" );
+
+  return r;
+}
+
+int  disk( int op, uint32_t a, void* x ) {
+  int r;
+
+  asm volatile( "mov r0, %2 \n" // assign r0 = op
+                "mov r1, %3 \n" // assign r1 =  a
+                "mov r2, %4 \n" // assign r2 =  x
+                "mov r7, %1 \n" // assign r7 = SYS_DISK
+                "svc #0     \n" // make system call
+                "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r) 
+              : "I" (SYS_DISK), "r" (op), "r" (a), "r" (x)
+              : "r0", "r1", "r2", "memory", "r7" );
+
+  return r;
+}
+
+uint32_t cycle_count() {
+  uint32_t r;
+
+  asm volatile( "mrc p15, 0, %0, c9, c13, 0 \n" // read PMCCNTR
+              : "=r" (r) );
+
+  return r;
+}
+
+uint64_t clock_cycles() {
+  uint32_t seq, high, low, now;
+
+  do {
+    seq  = vdso.seq;      asm volatile( "dmb" ::: "memory" );
+    high = vdso.high;
+    low  = vdso.low;
+    now  = *vdso.counter; asm volatile( "dmb" ::: "memory" );
+  } while( ( seq & 1 ) || ( seq != vdso.seq ) );
+
+  if( now < low ) {
+    high++; // counter wrapped around since last update
+  }
+
+  return ( ( uint64_t )( high ) << 32 ) | now;
+}
+
+uint64_t clock_ns() {
+  uint64_t t = clock_cycles();
+
+  return ( ( t / vdso.freq ) * 1000000000 ) + ( ( ( t % vdso.freq ) * 1000000000 ) / vdso.freq );
+}
+
+int  clock_gettime( clockid_t clk, struct timespec* ts ) {
+  uint32_t lo, hi; uint64_t ns;
+
+  if( vdso.freq != 0 ) { // fast path: read vDSO page
+    ns = clock_ns();
+  }
+  else {                 // slow path: make system call
+    asm volatile( "mov r0, %3 \n" // assign r0 = clk
+                  "mov r7, %2 \n" // assign r7 = SYS_CLOCK_GETTIME
+                  "svc #0     \n" // make system call
+                  "mov %0, r0 \n" // assign lo = r0
+                  "mov %1, r1 \n" // assign hi = r1
+                : "=r" (lo), "=r" (hi)
+                : "I" (SYS_CLOCK_GETTIME), "r" (clk)
+                : "r0", "r1", "r7" );
+
+    ns = ( ( uint64_t )( hi ) << 32 ) | lo;
+  }
+
+  ts->tv_sec  = ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+
+  return 0;
+}
+
+/* The atomic operations use an exclusive load/store pair: strex fails (and
+ * the sequence is retried) if anything else wrote to *x since the ldrex, so
+ * the read-modify-write is atomic wrt. other processes and interrupts.  The
+ * dmb instructions order the operation wrt. surrounding memory accesses.
+ */
+
+int atomic_cas ( volatile int* x, int old, int y ) {
+  int r, t;
+
+  asm volatile( "dmb             \n"
+                "0:              \n"
+                "ldrex %0, [ %2 ] \n" // load  r = *x, marking exclusive access
+                "cmp   %0, %3     \n"
+                "bne   1f         \n" // give up iff. r != old
+                "strex %1, %4, [ %2 ] \n" // store *x = y iff. still exclusive
+                "cmp   %1, #0     \n"
+                "bne   0b         \n" // retry iff. store failed
+                "1:              \n"
+                "dmb             \n"
+              : "=&r" (r), "=&r" (t)
+              : "r" (x), "r" (old), "r" (y)
+              : "cc", "memory" );
+
+  return r;
+}
+
+int atomic_xchg( volatile int* x,          int y ) {
+  int r, t;
+
+  asm volatile( "dmb             \n"
+                "0:              \n"
+                "ldrex %0, [ %2 ] \n" // load  r = *x, marking exclusive access
+                "strex %1, %3, [ %2 ] \n" // store *x = y iff. still exclusive
+                "cmp   %1, #0     \n"
+                "bne   0b         \n" // retry iff. store failed
+                "dmb             \n"
+              : "=&r" (r), "=&r" (t)
+              : "r" (x), "r" (y)
+              : "cc", "memory" );
+
+  return r;
+}
+
+int atomic_add ( volatile int* x,          int y ) {
+  int r, t;
+
+  asm volatile( "dmb             \n"
+                "0:              \n"
+                "ldrex %0, [ %2 ] \n" // load  r = *x, marking exclusive access
+                "add   %0, %0, %3 \n" //       r = r + y
+                "strex %1, %0, [ %2 ] \n" // store *x = r iff. still exclusive
+                "cmp   %1, #0     \n"
+                "bne   0b         \n" // retry iff. store failed
+                "dmb             \n"
+              : "=&r" (r), "=&r" (t)
+              : "r" (x), "r" (y)
+              : "cc", "memory" );
+
+  return r;
+}
+
+/* The mutex follows the three-state design of Drepper's "Futexes Are
+ * Tricky": lock and unlock only make a system call if the state shows
+ * another process is (or may be) waiting.
+ */
+
+void mutex_lock   ( mutex_t* m ) {
+  int c = atomic_cas( &m->state, 0, 1 );
+
+  if( c != 0 ) {
+    if( c != 2 ) {
+      c = atomic_xchg( &m->state, 2 );
+    }
+    while( c != 0 ) {
+      futex( &m->state, FUTEX_WAIT, 2 );
+      c = atomic_xchg( &m->state, 2 );
+    }
+  }
+
+  return;
+}
+
+bool mutex_trylock( mutex_t* m ) {
+  return atomic_cas( &m->state, 0, 1 ) == 0;
+}
+
+void mutex_unlock ( mutex_t* m ) {
+  if( atomic_add( &m->state, -1 ) != 0 ) {
+    m->state = 0;
+    futex( &m->state, FUTEX_WAKE, 1 );
+  }
+
+  return;
+}
+
+void cond_wait     ( cond_t* c, mutex_t* m ) {
+  int seq = c->seq;
+
+  atomic_add( &c->waiters, 1 );
+  mutex_unlock( m );
+
+  futex( &c->seq, FUTEX_WAIT, seq ); // returns at once if signalled since
+
+  atomic_add( &c->waiters, -1 );
+  mutex_lock( m );
+
+  return;
+}
+
+bool cond_timedwait( cond_t* c, mutex_t* m, uint32_t ms ) {
+  int seq = c->seq;
+
+  atomic_add( &c->waiters, 1 );
+  mutex_unlock( m );
+
+  int r = futex_timed( &c->seq, seq, ms ); // returns at once if signalled since
+
+  atomic_add( &c->waiters, -1 );
+  mutex_lock( m );
+
+  return r != -2;
+}
+
+void cond_signal   ( cond_t* c ) {
+  atomic_add( &c->seq, 1 );
+
+  if( c->waiters > 0 ) {
+    futex( &c->seq, FUTEX_WAKE, 1 );
+  }
+
+  return;
+}
+
+void cond_broadcast( cond_t* c ) {
+  atomic_add( &c->seq, 1 );
+
+  if( c->waiters > 0 ) {
+    futex( &c->seq, FUTEX_WAKE, c->waiters );
+  }
+
+  return;
+}
+
+void sem_init( sem_t* s, int x ) {
+  s->count   = x;
+  s->waiters = 0;
+
+  return;
+}
+
+void sem_wait( sem_t* s ) {
+  while( 1 ) {
+    int c = s->count;
+
+    if( c > 0 ) {
+      if( atomic_cas( &s->count, c, c - 1 ) == c ) {
+        return;
+      }
+    }
+    else {
+      atomic_add( &s->waiters, 1 );
+      futex( &s->count, FUTEX_WAIT, 0 ); // returns at once if posted since
+      atomic_add( &s->waiters, -1 );
+    }
+  }
+}
+
+bool sem_timedwait( sem_t* s, uint32_t ms ) {
+  while( 1 ) {
+    int c = s->count;
+
+    if( c > 0 ) {
+      if( atomic_cas( &s->count, c, c - 1 ) == c ) {
+        return true;
+      }
+    }
+    else {
+      atomic_add( &s->waiters, 1 );
+      int r = futex_timed( &s->count, 0, ms ); // returns at once if posted since
+      atomic_add( &s->waiters, -1 );
+
+      if( r == -2 ) {
+        return false;
+      }
+    }
+  }
+}
+
+void sem_post( sem_t* s ) {
+  atomic_add( &s->count, 1 );
+
+  if( s->waiters > 0 ) {
+    futex( &s->count, FUTEX_WAKE, 1 );
+  }
+
+  return;
+}
+
+/* stdout and stderr are statically allocated, so shared by all processes
+ * (see libc.h); stderr has a buffer too, since even unbuffered output is
+ * written with one system call per call.
+ */
+
+char stdioOutBuf[ BUFSIZ ];
+char stdioErrBuf[ BUFSIZ ];
+
+FILE stdioOut = { STDOUT_FILENO, _IOLBF, stdioOutBuf, BUFSIZ, 0, false, MUTEX_INITIALIZER };
+FILE stdioErr = { STDERR_FILENO, _IONBF, stdioErrBuf, BUFSIZ, 0, false, MUTEX_INITIALIZER };
+
+FILE* stdout = &stdioOut;
+FILE* stderr = &stdioErr;
+
+// write the bytes buffered in f then the n bytes at x, with one writev per attempt; the caller must hold f->lock; return 0 for success, or EOF if a write failed
+
+int stdio_flush( FILE* f, const void* x, size_t n ) {
+  struct iovec iov[ 2 ] = { { f->buf, f->n }, { ( void* )( x ), n } };
+
+  f->n = 0;
+
+  for( int i = 0; true; ) {
+    while( ( i < 2 ) && ( iov[ i ].iov_len == 0 ) ) {
+      i++;
+    }
+    if( i == 2 ) {
+      return 0;
+    }
+
+    int r = writev( f->fd, &iov[ i ], 2 - i );
+
+    if( r <= 0 ) { // discard the rest, rather than retry forever
+      f->error = true; return EOF;
+    }
+
+    for( ; r > 0; i++ ) { // skip what was written, which may end part way through a buffer
+      size_t m = ( ( size_t )( r ) < iov[ i ].iov_len ) ? ( size_t )( r ) : iov[ i ].iov_len;
+
+      iov[ i ].iov_base = ( char* )( iov[ i ].iov_base ) + m;
+      iov[ i ].iov_len -= m; r -= m;
+
+      if( iov[ i ].iov_len != 0 ) {
+        break;
+      }
+    }
+  }
+}
+
+// buffer c in f, flushing it first if full; the caller must hold f->lock; return c, or EOF if a write failed
+
+int stdio_putc( FILE* f, char c ) {
+  if( f->size == 0 ) {
+    return ( stdio_flush( f, &c, 1 ) == 0 ) ? ( uint8_t )( c ) : EOF;
+  }
+  if( ( f->n == f->size ) && ( stdio_flush( f, NULL, 0 ) != 0 ) ) {
+    return EOF;
+  }
+
+  f->buf[ f->n++ ] = c;
+
+  return ( uint8_t )( c );
+}
+
+// end a call which wrote to f, flushing it per its buffering mode, given whether a newline was written; the caller must hold f->lock
+
+int stdio_end( FILE* f, bool nl ) {
+  if( ( f->mode == _IONBF ) || ( ( f->mode == _IOLBF ) && nl ) ) {
+    return stdio_flush( f, NULL, 0 );
+  }
+
+  return 0;
+}
+
+int setvbuf( FILE* f, char* x, int mode, size_t size ) {
+  if( ( mode != _IOFBF ) && ( mode != _IOLBF ) && ( mode != _IONBF ) ) {
+    return EOF;
+  }
+
+  mutex_lock( &f->lock );
+
+  int r = stdio_flush( f, NULL, 0 );
+
+  if( x != NULL ) {
+    f->buf  = x;
+    f->size = size;
+  }
+  f->mode = mode;
+
+  mutex_unlock( &f->lock );
+
+  return r;
+}
+
+int fflush( FILE* f ) {
+  if( f == NULL ) {
+    int r = fflush( stdout );
+    return ( fflush( stderr ) == 0 ) ? r : EOF;
+  }
+
+  mutex_lock( &f->lock );
+  int r = stdio_flush( f, NULL, 0 );
+  mutex_unlock( &f->lock );
+
+  return r;
+}
+
+// flush stdout and stderr as fflush( NULL ) does, except skip either whose lock is held (e.g., by a process killed part way through a call) rather than block
+
+void stdio_exit() {
+  FILE* f[ 2 ] = { stdout, stderr };
+
+  for( int i = 0; i < 2; i++ ) {
+    if( mutex_trylock( &f[ i ]->lock ) ) {
+      stdio_flush( f[ i ], NULL, 0 );
+      mutex_unlock( &f[ i ]->lock );
+    }
+  }
+
+  return;
+}
+
+bool ferror( FILE* f ) {
+  return f->error;
+}
+
+void clearerr( FILE* f ) {
+  f->error = false;
+}
+
+size_t fwrite( const void* x, size_t size, size_t n, FILE* f ) {
+  size_t m = size * n; int r;
+
+  if( m == 0 ) {
+    return 0;
+  }
+
+  mutex_lock( &f->lock );
+
+  if( m > ( f->size - f->n ) ) { // won't fit, so write buffer plus x at once
+    r = stdio_flush( f, x, m );
+  }
+  else {
+    memcpy( f->buf + f->n, x, m ); f->n += m;
+    r = stdio_end( f, memchr( x, '\n', m ) != NULL );
+  }
+
+  mutex_unlock( &f->lock );
+
+  return ( r == 0 ) ? n : 0;
+}
+
+int fputc( int c, FILE* f ) {
+  mutex_lock( &f->lock );
+
+  int r = stdio_putc( f, c );
+  if( ( r != EOF ) && ( stdio_end( f, c == '\n' ) != 0 ) ) {
+    r = EOF;
+  }
+
+  mutex_unlock( &f->lock );
+
+  return r;
+}
+
+int fputs( const char* x, FILE* f ) {
+  size_t n = strlen( x );
+
+  return ( fwrite( x, 1, n, f ) == n ) ? 0 : EOF;
+}
+
+int putchar( int c ) {
+  return fputc( c, stdout );
+}
+
+/* The printf family shares one formatter, which writes either to a FILE
+ * (whose lock the caller holds) or to a string (truncating it, but still
+ * counting the characters which would have been written).
+ */
+
+typedef struct {
+  FILE*      f;                 // output FILE, or NULL for a string
+  char*      x;                 // output string
+  size_t  size;                 // output string size (in bytes)
+  size_t     n;                 // number of characters written
+  bool      nl;                 // a newline was written
+  bool   error;                 // a write failed
+} stdio_out_t;
+
+void stdio_out( stdio_out_t* o, char c ) {
+  if( o->f != NULL ) {
+    if( stdio_putc( o->f, c ) == EOF ) {
+      o->error = true;
+    }
+  }
+  else if( ( o->n + 1 ) < o->size ) {
+    o->x[ o->n ] = c;
+  }
+
+  o->nl |= ( c == '\n' ); o->n++;
+}
+
+void stdio_pad( stdio_out_t* o, char c, int n ) {
+  for( int i = 0; i < n; i++ ) {
+    stdio_out( o, c );
+  }
+}
+
+void stdio_format( stdio_out_t* o, const char* fmt, va_list args ) {
+  for( ; *fmt != '\0'; fmt++ ) {
+    if( *fmt != '%' ) {
+      stdio_out( o, *fmt ); continue;
+    }
+
+    bool left = false, zero = false; char sign = '\0';
+
+    for( fmt++; true; fmt++ ) { // flags
+      if     ( *fmt == '-' ) { left = true; }
+      else if( *fmt == '0' ) { zero = true; }
+      else if( *fmt == '+' ) { sign = '+';  }
+      else if( *fmt == ' ' ) { sign = ( sign == '+' ) ? '+' : ' '; }
+      else                   { break; }
+    }
+
+    int width = 0, prec = -1;
+
+    if( *fmt == '*' ) { // width
+      width = va_arg( args, int ); fmt++;
+      if( width < 0 ) {
+        left = true; width = -width;
+      }
+    }
+    else {
+      for( ; ( *fmt >= '0' ) && ( *fmt <= '9' ); fmt++ ) {
+        width = ( width * 10 ) + ( *fmt - '0' );
+      }
+    }
+
+    if( *fmt == '.' ) { // precision
+      fmt++; prec = 0;
+      if( *fmt == '*' ) {
+        prec = va_arg( args, int ); fmt++;
+        prec = ( prec < 0 ) ? -1 : prec;
+      }
+      else {
+        for( ; ( *fmt >= '0' ) && ( *fmt <= '9' ); fmt++ ) {
+          prec = ( prec * 10 ) + ( *fmt - '0' );
+        }
+      }
+    }
+
+    int len = 0; // length modifier, i.e., number of l's
+
+    for( ; *fmt == 'l'; fmt++ ) {
+      len++;
+    }
+
+    char t[ 24 ]; const char* x = t; int n = 0; // converted characters
+    const char* pre = "";                     // prefix, i.e., sign or 0x
+    uint64_t u = 0; int base = 0; const char* digits = "0123456789abcdef";
+
+    switch( *fmt ) {
+      case 'd' :
+      case 'i' : {
+        int64_t v = ( len >= 2 ) ? va_arg( args, long long ) : ( len == 1 ) ? va_arg( args, long ) : va_arg( args, int );
+        u   = ( v < 0 ) ? -( uint64_t )( v ) : ( uint64_t )( v ); base = 10;
+        pre = ( v < 0 ) ? "-" : ( sign == '+' ) ? "+" : ( sign == ' ' ) ? " " : "";
+        break;
+      }
+      case 'u' :
+      case 'x' :
+      case 'X' :
+      case 'o' : {
+        u    = ( len >= 2 ) ? va_arg( args, unsigned long long ) : ( len == 1 ) ? va_arg( args, unsigned long ) : va_arg( args, unsigned int );
+        base = ( *fmt == 'u' ) ? 10 : ( *fmt == 'o' ) ? 8 : 16;
+        digits = ( *fmt == 'X' ) ? "0123456789ABCDEF" : digits;
+        break;
+      }
+      case 'p' : {
+        u = ( uintptr_t )( va_arg( args, void* ) ); base = 16; pre = "0x";
+        break;
+      }
+      case 'c' : {
+        t[ 0 ] = ( char )( va_arg( args, int ) ); n = 1;
+        break;
+      }
+      case 's' : {
+        x = va_arg( args, const char* );
+        x = ( x == NULL ) ? "(null)" : x;
+        for( ; ( x[ n ] != '\0' ) && ( ( prec < 0 ) || ( n < prec ) ); n++ );
+        break;
+      }
+      case '\0' : {
+        return; // incomplete conversion at end of fmt
+      }
+      default : { // includes %%
+        t[ 0 ] = *fmt; n = 1;
+        break;
+      }
+    }
+
+    int z = 0; // leading zeros, for a numeric conversion
+
+    if( base != 0 ) {
+      char* p = t + sizeof( t );
+
+      if( u <= UINT32_MAX ) { // avoid 64-bit division where possible
+        for( uint32_t v = u; v != 0; v /= base ) {
+          *--p = digits[ v % base ];
+        }
+      }
+      else {
+        for( ; u != 0; u /= base ) {
+          *--p = digits[ u % base ];
+        }
+      }
+
+      x = p; n = ( t + sizeof( t ) ) - p;
+
+      if( prec >= 0 ) { // precision is minimum number of digits, and disables 0 flag
+        z = ( prec > n ) ? prec - n : 0; zero = false;
+      }
+      else if( n == 0 ) {
+        z = 1;
+      }
+    }
+    else {
+      zero = false;
+    }
+
+    int pad = width - ( int )( strlen( pre ) ) - z - n;
+
+    if( !left && !zero ) {
+      stdio_pad( o, ' ', pad );
+    }
+    for( ; *pre != '\0'; pre++ ) {
+      stdio_out( o, *pre );
+    }
+    if( !left &&  zero ) {
+      stdio_pad( o, '0', pad );
+    }
+    stdio_pad( o, '0', z );
+    for( int i = 0; i < n; i++ ) {
+      stdio_out( o, x[ i ] );
+    }
+    if(  left ) {
+      stdio_pad( o, ' ', pad );
+    }
+  }
+}
+
+int vfprintf( FILE* f, const char* fmt, va_list args ) {
+  stdio_out_t o = { f, NULL, 0, 0, false, false };
+
+  mutex_lock( &f->lock );
+
+  stdio_format( &o, fmt, args );
+  if( stdio_end( f, o.nl ) != 0 ) {
+    o.error = true;
+  }
+
+  mutex_unlock( &f->lock );
+
+  return o.error ? EOF : ( int )( o.n );
+}
+
+int fprintf( FILE* f, const char* fmt, ... ) {
+  va_list args; va_start( args, fmt );
+  int r = vfprintf( f, fmt, args );
+  va_end( args );
+
+  return r;
+}
+
+int printf( const char* fmt, ... ) {
+  va_list args; va_start( args, fmt );
+  int r = vfprintf( stdout, fmt, args );
+  va_end( args );
+
+  return r;
+}
+
+int vsnprintf( char* x, size_t n, const char* fmt, va_list args ) {
+  stdio_out_t o = { NULL, x, n, 0, false, false };
+
+  stdio_format( &o, fmt, args );
+  if( n > 0 ) {
+    x[ ( o.n < n ) ? o.n : n - 1 ] = '\0';
+  }
+
+  return ( int )( o.n );
+}
+
+int snprintf( char* x, size_t n, const char* fmt, ... ) {
+  va_list args; va_start( args, fmt );
+  int r = vsnprintf( x, n, fmt, args );
+  va_end( args );
+
+  return r;
+}
@@ -8,6 +8,7 @@
 #ifndef __LIBC_H
 #define __LIBC_H
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -25,7 +26,8 @@ typedef int pid_t;
  * 2. signal identifiers (as used by the kill system call), 
  * 3. status codes for exit,
  * 4. standard file descriptors (e.g., for read and write system calls),
- * 5. platform-specific constants, which may need calibration (wrt. the
+ * 5. futex operations (as used by the futex system call),
+ * 6. platform-specific constants, which may need calibration (wrt. the
  *    underlying hardware QEMU is executed on).
  *
  * They don't *precisely* match the standard C library, but are intended
@@ -43,6 +45,25 @@ typedef int pid_t;
 #define SYS_PIPE      ( 0x08 )
 #define SYS_CLOSE     ( 0x09 )
 #define SYS_PRINT_FDS ( 0x0A )
+#define SYS_FUTEX     ( 0x0B )
+#define SYS_SLEEP     ( 0x0C )
+#define SYS_READ_TIMED ( 0x0D )
+#define SYS_CLOCK_GETTIME ( 0x0E )
+#define SYS_TRACE     ( 0x0F )
+#define SYS_PROC_STATS ( 0x10 )
+#define SYS_SVC_STATS ( 0x11 )
+#define SYS_PROFILE   ( 0x12 )
+#define SYS_GETPID    ( 0x13 )
+#define SYS_DISK      ( 0x14 )
+#define SYS_SCHED_SETSCHEDULER ( 0x15 )
+#define SYS_GROUP_JOIN ( 0x16 )
+#define SYS_GROUP_QUOTA ( 0x17 )
+#define SYS_GROUP_STATS ( 0x18 )
+#define SYS_READV     ( 0x19 )
+#define SYS_WRITEV    ( 0x1A )
+#define SYS_PREAD     ( 0x1B )
+#define SYS_PWRITE    ( 0x1C )
+#define SYS_POLL      ( 0x1D )
 
 #define SIG_TERM      ( 0x00 )
 #define SIG_QUIT      ( 0x01 )
@@ -54,6 +75,198 @@ typedef int pid_t;
 #define STDOUT_FILENO ( 1 )
 #define STDERR_FILENO ( 2 )
 
+#define IOV_MAX       ( 16 )
+
+#define FUTEX_WAIT    ( 0 )
+#define FUTEX_WAKE    ( 1 )
+#define FUTEX_WAIT_TIMED ( 2 )
+
+#define TIMEOUT_INFINITE ( 0xFFFFFFFF )
+
+#define TRACE_OP_MASK ( 0 )
+#define TRACE_OP_DUMP ( 1 )
+
+#define PROFILE_OP_START ( 0 )
+#define PROFILE_OP_STOP  ( 1 )
+#define PROFILE_OP_DUMP  ( 2 )
+#define PROFILE_OP_DISK  ( 3 )
+
+#define DISK_OP_LEN   ( 0 )
+#define DISK_OP_READ  ( 1 )
+#define DISK_OP_WRITE ( 2 )
+#define DISK_OP_SYNC  ( 3 )
+
+#define SCHED_NORMAL  ( 0 )
+#define SCHED_FIFO    ( 1 )
+#define SCHED_RR      ( 2 )
+#define SCHED_RT_MAX  ( 99 )
+
+#define MAX_GROUPS    ( 8 )
+
+#define PROC_CREATED    ( 1 )
+#define PROC_TERMINATED ( 2 )
+#define PROC_READY      ( 3 )
+#define PROC_EXECUTING  ( 4 )
+#define PROC_WAITING    ( 5 )
+
+#ifndef MAX_SVCS // number of system call IDs, per Makefile
+#define MAX_SVCS      ( 32 )
+#endif
+#define SVC_HIST_BUCKETS ( 24 )
+
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC ( ( clockid_t )( 4 ) )
+#endif
+
+/* The kernel publishes a vDSO page which, since all processes share one
+ * address space, can be read directly: it allows the monotonic clock to be
+ * read with no system call.  The 32-bit counter is extended to 64 bits via
+ * the high word and last value recorded by the kernel; the sequence number
+ * is odd while the kernel is updating them, and changes after each update,
+ * so a reader retries if it observes either.  The layout must match vdso_t
+ * in kernel/clock.h.
+ */
+
+typedef struct {
+  volatile uint32_t          seq; // sequence number, odd while being updated
+  volatile uint32_t         high; // high word of 64-bit count
+  volatile uint32_t          low; // low  word of 64-bit count, at last update
+  volatile const uint32_t* counter; // free-running counter
+           uint32_t         freq; // counter frequency (Hz)
+} vdso_t;
+
+extern vdso_t vdso;
+
+/* A readv or writev system call scatters or gathers up to IOV_MAX buffers,
+ * in order, in one system call, and stops early at the first short read
+ * or write.  The layout must match iovec_t in kernel/hilevel.h.
+ */
+
+struct iovec {
+  void*  iov_base;              // address
+  size_t iov_len;               // length (in bytes)
+};
+
+/* A poll system call blocks until at least one of up to POLL_MAX fds is
+ * ready for the events of interest, then sets the events which occurred
+ * in each (where POLLERR, POLLHUP and POLLNVAL are reported regardless of
+ * interest).  The console is always ready for output on stdout, but never
+ * has input on stdin.  The layout must match pollfd_t in kernel/proc.h.
+ */
+
+#define POLL_MAX      ( 16 )
+
+#define POLLIN        ( 0x001 ) // data can be read without blocking
+#define POLLOUT       ( 0x004 ) // data can be written without blocking
+#define POLLERR       ( 0x008 ) // error, e.g., no read end is open for a pipe write end
+#define POLLHUP       ( 0x010 ) // hang up, i.e., no write end is open for a pipe read end
+#define POLLNVAL      ( 0x020 ) // fd is not open
+
+struct pollfd {
+  int      fd;                  // file descriptor, or < 0 to ignore
+  int16_t  events;              // events of interest
+  int16_t  revents;             // events which occurred
+};
+
+/* Synchronisation primitives are built on atomic operations over a shared
+ * word, and only invoke the futex system call under contention.  Since all
+ * processes share one address space, an object must live in static (i.e.,
+ * global) storage to be shared: a stack-allocated one is duplicated by fork.
+ */
+
+typedef struct {
+  volatile int state;   // 0 => unlocked, 1 => locked, 2 => locked with waiters
+} mutex_t;
+
+typedef struct {
+  volatile int seq;     // incremented by each signal or broadcast
+  volatile int waiters; // number of processes blocked in cond_wait
+} cond_t;
+
+typedef struct {
+  volatile int count;   // number of available units
+  volatile int waiters; // number of processes blocked in sem_wait
+} sem_t;
+
+/* The kernel accounts for the resource usage of each process: time is in
+ * cycles of the 24MHz counter (see vdso.freq).  A context switch counts as
+ * voluntary iff. the process blocked, yielded or terminated.  The wake
+ * latency is the time from being made ready (e.g., woken, or forked) to
+ * executing.  The layout must match pstats_t in kernel/proc.h.
+ */
+
+typedef struct {
+  uint64_t   userCycles;        // time executing in user mode
+  uint64_t kernelCycles;        // time executing system calls
+  uint64_t    irqCycles;        // time executing interrupt handlers
+  uint32_t        nvcsw;        // number of   voluntary context switches
+  uint32_t       nivcsw;        // number of involuntary context switches
+  uint32_t     svcCount[ MAX_SVCS ]; // number of calls, per system call ID
+  uint64_t   wakeCycles;        // total   wake latency
+  uint32_t      wakeMax;        // maximum wake latency
+  uint32_t      wakeNum;        // number of wake-ups
+} proc_stats_t;
+
+/* Processes can be placed in one of MAX_GROUPS groups, each of which can be
+ * limited to a quota of CPU time per period (over all of its processes and
+ * all CPUs); group 0, the default, is unlimited.  The layout must match
+ * gstats_t in kernel/hilevel.h.
+ */
+
+typedef struct {
+  uint32_t        quota;        // CPU time (in ms) per period, 0 if unlimited
+  uint32_t       period;        // period (in ms)
+  uint64_t   usedCycles;        // CPU time used in total
+  uint32_t    throttles;        // number of periods in which its quota was used up
+  uint32_t    throttled;        // non-zero iff. its quota is used up in the current period
+} group_stats_t;
+
+/* Output can be buffered, per a limited model of stdio: each FILE buffers
+ * output to a file descriptor, and writes it with one system call once the
+ * buffer is full, or
+ *
+ * - for _IOLBF (line buffering), once a newline is buffered, or
+ * - for _IONBF (no buffering),   at the end of each call,
+ *
+ * plus whenever fflush is invoked.  stdout is line buffered (so output
+ * costs one system call per line, rather than per fragment) and stderr is
+ * unbuffered; exit flushes both.  Since all processes share one address
+ * space, they share stdout and stderr: each FILE is guarded by a mutex, so
+ * the output of one call is never interleaved with that of another.  Note
+ * that a process killed during such a call never releases the mutex, so any
+ * later call on that FILE blocks forever; exit skips flushing a FILE whose
+ * mutex is held, so at least does not.
+ *
+ * The printf family supports the conversions %d, %i, %u, %x, %X, %o, %c,
+ * %s, %p and %%, with the flags -, 0, + and space, a width and precision
+ * (each of which may be *), and the length modifiers l and ll.
+ */
+
+#define EOF           ( -1 )
+
+#define BUFSIZ        ( 256 )
+
+#define _IOFBF        ( 0 ) // full buffering
+#define _IOLBF        ( 1 ) // line buffering
+#define _IONBF        ( 2 ) //   no buffering
+
+typedef struct {
+  int           fd;             // file descriptor
+  int         mode;             // buffering mode, i.e., _IOFBF, _IOLBF or _IONBF
+  char*        buf;             // buffer
+  size_t      size;             // buffer size (in bytes)
+  size_t         n;             // number of buffered bytes
+  bool       error;             // a write failed, since the last clearerr
+  mutex_t     lock;             // guards all of the above
+} FILE;
+
+extern FILE* stdout;
+extern FILE* stderr;
+
+#define MUTEX_INITIALIZER { 0 }
+#define  COND_INITIALIZER { 0, 0 }
+#define   SEM_INITIALIZER( x ) { ( x ), 0 }
+
 // convert ASCII string x into integer r
 extern int  atoi( char* x        );
 // convert integer x into ASCII string r
@@ -66,6 +279,17 @@ extern void yield();
 extern int write( int fd, const void* x, size_t n );
 // read  n bytes into x from the file descriptor fd; return bytes read
 extern int  read( int fd,       void* x, size_t n );
+// write the iovcnt buffers at iov, in order, to   the file descriptor fd; return bytes written
+extern int writev( int fd, const struct iovec* iov, int iovcnt );
+// read  into the iovcnt buffers at iov, in order, from the file descriptor fd; return bytes read
+extern int  readv( int fd, const struct iovec* iov, int iovcnt );
+// write n bytes from x to   the file descriptor fd at offset off, leaving its position unchanged; return bytes written, or -1 if fd has no position (e.g., is a pipe)
+extern int pwrite( int fd, const void* x, size_t n, int32_t off );
+// read  n bytes into x from the file descriptor fd at offset off, leaving its position unchanged; return bytes read,    or -1 if fd has no position (e.g., is a pipe)
+extern int  pread( int fd,       void* x, size_t n, int32_t off );
+
+// block until one of the nfds fds at fds is ready, or for at most ms (unless ms < 0); return the number ready (0 if timed out), or -1 for failure
+extern int   poll( struct pollfd* fds, int nfds, int ms );
 
 // perform fork, returning 0 iff. child or > 0 iff. parent process
 extern int  fork();
@@ -74,10 +298,19 @@ extern void exit(       int   x );
 // perform exec, i.e., start executing program at address x
 extern void exec( const void* x );
 
-// for process identified by pid, send signal of x
+// for process identified by pid, send signal of x; return 0, or -1 if there is no such process
 extern int  kill( pid_t pid, int x );
 // for process identified by pid, set  priority to x
 extern void nice( pid_t pid, int x );
+// for process identified by pid, set  scheduling class to policy (i.e., SCHED_*) and real-time priority to priority (0 iff. SCHED_NORMAL, else 1...SCHED_RT_MAX); return 0 for success, -1 for failure
+extern int  sched_setscheduler( pid_t pid, int policy, int priority );
+
+// move process identified by pid into group gid; return 0 for success, -1 for failure
+extern int  group_join( pid_t pid, int gid );
+// limit the processes in group gid (> 0) to quota ms of CPU time per period ms, or remove the limit iff. quota is 0; return 0 for success, -1 for failure
+extern int  group_quota( int gid, uint32_t quota, uint32_t period );
+// read usage of group gid into x; return the number of processes in it, or -1 if gid is invalid
+extern int  group_stats( int gid, group_stats_t* x );
 
 // create a pipe which can be read from at pipedes[0] and written to at pipedes[1], returning 0 for success, -1 for failure
 extern int pipe( int pipedes[2] ); 
@@ -88,4 +321,103 @@ extern int close( int fd );
 // print fd details buffer debugger
 extern void print_fds();
 
+// if op is FUTEX_WAIT, block iff. *addr == x; if op is FUTEX_WAKE, wake up to x waiters on addr
+extern int futex( volatile int* addr, int op, int x );
+// block iff. *addr == x, for at most ms; return 0 if woken, -1 if *addr != x, -2 if timed out
+extern int futex_timed( volatile int* addr, int x, uint32_t ms );
+
+// block for (at least) ms milliseconds; sleep_ms( 0 ) is equivalent to yield()
+extern void sleep_ms( uint32_t ms );
+// block for (at least) the time in req, rounded up to a millisecond; rem, if not NULL, is zeroed
+extern int  nanosleep( const struct timespec* req, struct timespec* rem );
+
+// read up to n bytes into x from the pipe fd, blocking for at most ms until some are available; return bytes read
+extern int  read_timed( int fd, void* x, size_t n, uint32_t ms );
+
+// if op is TRACE_OP_MASK, select kernel trace events per bits of x (returning previous selection); if op is TRACE_OP_DUMP, print all recorded events
+extern uint32_t ktrace( int op, uint32_t x );
+
+// read resource usage of process pid (or, if pid < 0, the idle process of CPU -1 - pid) into x; return its status (PROC_*), or -1 if none
+extern int proc_stats( pid_t pid, proc_stats_t* x );
+
+// read latency histogram of system call svc into x, where x[ i ] counts calls taking [2^i, 2^(i+1)) cycles; return number of calls, or -1 if svc is invalid
+extern int svc_stats( int svc, uint32_t x[ SVC_HIST_BUCKETS ] );
+
+// if op is PROFILE_OP_START, start sampling profiler with a period of x microseconds; if op is PROFILE_OP_STOP, stop it; if op is PROFILE_OP_DUMP or PROFILE_OP_DISK, stop it then dump the samples to UART0 or the disk respectively
+extern int profile( int op, uint32_t x );
+
+// return the PID of the executing process
+extern pid_t getpid();
+
+// if op is DISK_OP_LEN, return the disk block length; if op is DISK_OP_READ or DISK_OP_WRITE, read or write the block at address a into or from x (of block length bytes), where a write may be buffered; if op is DISK_OP_SYNC, wait until every buffered write is complete; return < 0 for failure (including, for DISK_OP_SYNC, of any buffered write)
+extern int disk( int op, uint32_t a, void* x );
+
+// read the PMU cycle counter of the executing CPU (which is enabled for user mode by the kernel)
+extern uint32_t cycle_count();
+
+// read monotonic clock into ts, via the vDSO page; return 0 for success
+extern int      clock_gettime( clockid_t clk, struct timespec* ts );
+// read monotonic clock as a 64-bit count of 1 / vdso.freq sec. ticks, via the vDSO page
+extern uint64_t clock_cycles();
+// read monotonic clock in nanoseconds, via the vDSO page
+extern uint64_t clock_ns();
+
+// atomically replace *x with y iff. *x == old, returning the previous value of *x
+extern int atomic_cas ( volatile int* x, int old, int y );
+// atomically replace *x with y, returning the previous value of *x
+extern int atomic_xchg( volatile int* x,          int y );
+// atomically add y to *x, returning the new value of *x
+extern int atomic_add ( volatile int* x,          int y );
+
+// acquire mutex m, blocking while it is held by another process
+extern void mutex_lock   ( mutex_t* m );
+// try to acquire mutex m without blocking, returning true on success
+extern bool mutex_trylock( mutex_t* m );
+// release mutex m, waking a waiter if there is one
+extern void mutex_unlock ( mutex_t* m );
+
+// release mutex m and block until c is signalled, then re-acquire m
+extern void cond_wait     ( cond_t* c, mutex_t* m );
+// ditto, but for at most ms; return false iff. timed out
+extern bool cond_timedwait( cond_t* c, mutex_t* m, uint32_t ms );
+// wake one  process waiting on c
+extern void cond_signal   ( cond_t* c );
+// wake all  processes waiting on c
+extern void cond_broadcast( cond_t* c );
+
+// initialise semaphore s with a count of x
+extern void sem_init( sem_t* s, int x );
+// decrement s, blocking while its count is zero
+extern void sem_wait( sem_t* s );
+// ditto, but for at most ms per attempt; return false iff. timed out
+extern bool sem_timedwait( sem_t* s, uint32_t ms );
+// increment s, waking a waiter if there is one
+extern void sem_post( sem_t* s );
+
+// set the buffering mode of f to mode, using the buffer of size bytes at x (or, if x is NULL, the existing one); flushes f first, return 0 for success
+extern int    setvbuf( FILE* f, char* x, int mode, size_t size );
+// write any output buffered in f (or, if f is NULL, in stdout and stderr); return 0 for success, or EOF if a write failed
+extern int    fflush ( FILE* f );
+// return true iff. a write to f failed, since the last clearerr
+extern bool   ferror ( FILE* f );
+// clear the error flag of f
+extern void   clearerr( FILE* f );
+
+// write n elements of size bytes from x to f; return the number of complete elements written
+extern size_t fwrite ( const void* x, size_t size, size_t n, FILE* f );
+// write character c to f; return c, or EOF for failure
+extern int    fputc  ( int c, FILE* f );
+// write string x to f; return >= 0 for success, or EOF for failure
+extern int    fputs  ( const char* x, FILE* f );
+// write character c to stdout; return c, or EOF for failure
+extern int    putchar( int c );
+
+// write to f (or stdout) the output of format string fmt for the subsequent arguments; return number of characters written, or < 0 for failure
+extern int   vfprintf( FILE* f, const char* fmt, va_list args );
+extern int    fprintf( FILE* f, const char* fmt, ... );
+extern int     printf(          const char* fmt, ... );
+// write to x the output of format string fmt for the subsequent arguments, truncated to at most n - 1 characters then terminated; return the number of characters the complete output has
+extern int  vsnprintf( char* x, size_t n, const char* fmt, va_list args );
+extern int   snprintf( char* x, size_t n, const char* fmt, ... );
+
 #endif
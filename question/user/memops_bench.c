@@ -0,0 +1,98 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "memops_bench.h"
+
+/* This program compares the implementations of memcpy, memset, memmove and
+ * strcmp, by measuring (via the PMU cycle counter) each one for a range of
+ * lengths, with word-aligned and misaligned addresses.  Each measurement is
+ * written as a line
+ *
+ * <function> <implementation> <length> <offset> <cycles>
+ *
+ * where the libc implementation is whichever the build selected: to compare
+ * with newlib, build with PROJECT_STRING = newlib.
+ */
+
+char benchSrc[ BENCH_MAX_LEN + 8 ];
+char benchDst[ BENCH_MAX_LEN + 8 ];
+
+typedef void* ( *bench_copy_t )( void* x, const void* y, size_t n );
+typedef void* ( *bench_fill_t )( void* x,       int   c, size_t n );
+typedef int   ( *bench_cmp_t  )( const char* x, const char* y );
+
+void bench_report( char* f, char* impl, int n, int offset, uint32_t t ) {
+  printf( "%s %s %d %d %u\n", f, impl, n, offset, t );
+}
+
+uint32_t bench_copy( bench_copy_t f, char* x, char* y, int n ) {
+  uint32_t r = UINT32_MAX;
+
+  for( int i = 0; i < BENCH_REPS; i++ ) {
+    uint32_t t = cycle_count(); f( x, y, n ); t = cycle_count() - t;
+
+    r = ( t < r ) ? t : r;
+  }
+
+  return r;
+}
+
+uint32_t bench_fill( bench_fill_t f, char* x, int n ) {
+  uint32_t r = UINT32_MAX;
+
+  for( int i = 0; i < BENCH_REPS; i++ ) {
+    uint32_t t = cycle_count(); f( x, i, n ); t = cycle_count() - t;
+
+    r = ( t < r ) ? t : r;
+  }
+
+  return r;
+}
+
+uint32_t bench_cmp( bench_cmp_t f, char* x, char* y ) {
+  uint32_t r = UINT32_MAX;
+
+  for( int i = 0; i < BENCH_REPS; i++ ) {
+    uint32_t t = cycle_count(); f( x, y ); t = cycle_count() - t;
+
+    r = ( t < r ) ? t : r;
+  }
+
+  return r;
+}
+
+void main_memops_bench() {
+  int lens[] = { 16, 64, 256, 1024, BENCH_MAX_LEN };
+
+  for( int i = 0; i < sizeof( lens ) / sizeof( int ); i++ ) {
+    for( int offset = 0; offset < 2; offset++ ) {
+      int n = lens[ i ]; char* x = benchDst + offset; char* y = benchSrc;
+
+      bench_report( "memcpy",  "libc", n, offset, bench_copy( &memcpy,       x, y, n ) );
+      bench_report( "memcpy",  "arm",  n, offset, bench_copy( &memcpy_arm,  x, y, n ) );
+      bench_report( "memcpy",  "neon", n, offset, bench_copy( &memcpy_neon, x, y, n ) );
+
+      bench_report( "memset",  "libc", n, offset, bench_fill( &memset,       x,    n ) );
+      bench_report( "memset",  "arm",  n, offset, bench_fill( &memset_arm,   x,    n ) );
+      bench_report( "memset",  "neon", n, offset, bench_fill( &memset_neon,  x,    n ) );
+
+      // overlapping, so the backward copy is exercised
+      bench_report( "memmove", "libc", n, offset, bench_copy( &memmove,       x + 4, x, n ) );
+      bench_report( "memmove", "arm",  n, offset, bench_copy( &memmove_arm,   x + 4, x, n ) );
+      bench_report( "memmove", "neon", n, offset, bench_copy( &memmove_neon,  x + 4, x, n ) );
+
+      // equal strings, so every byte is compared
+      memset( y, 'a', n - 1 ); y[ n - 1 ] = '\x00';
+      memset( x, 'a', n - 1 ); x[ n - 1 ] = '\x00';
+
+      bench_report( "strcmp",  "libc", n, offset, bench_cmp( &strcmp,       x, y ) );
+      bench_report( "strcmp",  "arm",  n, offset, bench_cmp( &strcmp_arm,   x, y ) );
+    }
+  }
+
+  exit( EXIT_SUCCESS );
+}
@@ -0,0 +1,23 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of 
+ * which can be found via http://creativecommons.org (and should be included as 
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __MEMOPS_BENCH_H
+#define __MEMOPS_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "libc.h"
+#include "memops.h"
+
+#define BENCH_REPS    (   32 ) // repetitions per measurement, of which the minimum is reported
+#define BENCH_MAX_LEN ( 4096 )
+
+#endif
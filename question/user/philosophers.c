@@ -20,27 +20,27 @@
  * have eaten least recently first access to the chopsticks.
  */
 
-void writePhilosoperID(int id)
+// Write "\nPhilosopher <id + 1> " then n bytes of x, in one system call
+void writePhilosoperID(int id, const char *x, size_t n)
 {
-    write(STDOUT_FILENO, "\nPhilosopher ", 13);
-
     id++;
     char id_str[3];
     itoa(id_str, id);
-    if (id < 10)
-        write(STDOUT_FILENO, id_str, 1);
-    else
-        write(STDOUT_FILENO, id_str, 2);
 
-    write(STDOUT_FILENO, " ", 1);
+    struct iovec iov[4] = {
+        {"\nPhilosopher ", 13},
+        {id_str, (id < 10) ? 1 : 2},
+        {" ", 1},
+        {(void *)x, n}};
+
+    writev(STDOUT_FILENO, iov, 4);
 
     return;
 }
 
 void think(int id)
 {
-    writePhilosoperID(id);
-    write(STDOUT_FILENO, "is thinking", 11);
+    writePhilosoperID(id, "is thinking", 11);
 
     return;
 }
@@ -49,8 +49,7 @@ bool requestChopsticks(int id, int fd_write)
 {
     int n = write(fd_write, "R", 1); // Request chopsticks from waiter
 
-    writePhilosoperID(id);
-    write(STDOUT_FILENO, "request chopsticks", 18);
+    writePhilosoperID(id, "request chopsticks", 18);
 
     return n;
 }
@@ -66,8 +65,7 @@ int getWaiterReply(int id, int fd_read)
 
 void eat(int id)
 {
-    writePhilosoperID(id);
-    write(STDOUT_FILENO, "is eating", 9);
+    writePhilosoperID(id, "is eating", 9);
 
     return;
 }
@@ -76,8 +74,7 @@ bool putDownChopsticks(int id, int fd_write)
 {
     int n = write(fd_write, "P", 1); //Tell waiter putting chopsticks down
 
-    writePhilosoperID(id);
-    write(STDOUT_FILENO, "putting chopsticks down", 23);
+    writePhilosoperID(id, "putting chopsticks down", 23);
 
     return n;
 }
@@ -110,8 +107,7 @@ void philosopher(int id, int fd_read, int fd_write)
         }
         case 2: // chopsticks available
         {
-            writePhilosoperID(id);
-            write(STDOUT_FILENO, "picking chopsticks up", 21);
+            writePhilosoperID(id, "picking chopsticks up", 21);
             status = HOLDING_CHOPSTICK;
             eat(id);
             break;
@@ -193,9 +189,23 @@ void main_philosophers()
 
     yield();
 
+    struct pollfd fds[NUM_PHILOSOPHERS]; // NUM_PHILOSOPHERS <= POLL_MAX
+    for (int id = 0; id < NUM_PHILOSOPHERS; id++)
+    {
+        fds[id].fd = fd_waiterRead[id];
+        fds[id].events = POLLIN;
+    }
+
     // parent => waiter
     while (1)
     {
+        // block until a philosopher has sent a message, then read only from those which have
+        if (poll(fds, NUM_PHILOSOPHERS, -1) < 0)
+        {
+            write(STDOUT_FILENO, "\nERROR: poll failed", 19);
+            exit(EXIT_FAILURE);
+        }
+
         write(STDOUT_FILENO, "\nWaiter", 7);
         // print_fds();
 
@@ -213,7 +223,7 @@ void main_philosophers()
                 {
                     // handle chopstick pick up/put down requests
                     char r[1] = "X";
-                    int n = read(fd_waiterRead[id], r, 1); // read message from philosopher
+                    int n = (fds[id].revents & POLLIN) ? read(fd_waiterRead[id], r, 1) : 0; // read message from philosopher
                     // writePhilosoperID(id);
                     if (n == 1)
                     {
@@ -249,8 +259,7 @@ void main_philosophers()
 
                         else
                         {
-                            writePhilosoperID(id);
-                            write(STDOUT_FILENO, "\nERROR: not valid request", 25);
+                            writePhilosoperID(id, "\nERROR: not valid request", 25);
                             exit(EXIT_FAILURE);
                         }
                     }
@@ -262,7 +271,6 @@ void main_philosophers()
             p++;
         }
         // print_fds();
-        yield();
     }
 
     exit(EXIT_SUCCESS);
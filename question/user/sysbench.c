@@ -0,0 +1,372 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#include "sysbench.h"
+
+/* This program measures the cost of kernel operations: a null system call,
+ * a yield round trip between two processes, a pipe round trip and stream
+ * at several message sizes, the wakeup latency of a real-time process, fork
+ * plus exit, and disk block reads and (buffered or synchronous) writes.
+ * The results are written, between "#sysbench" and "#end" lines, as lines
+ *
+ * <benchmark> <parameter> <repetitions> <min> <median> <max> <ns>
+ *
+ * where min, median and max are PMU cycles per operation, and ns is the mean
+ * wall-clock time per operation in nanoseconds (so, e.g., pipe throughput is
+ * parameter * 10^9 / ns bytes per second).  The parameter is the message or
+ * block size in bytes, or the number of processes involved.
+ *
+ * Note that the console polls UART1, so is always ready: it competes for the
+ * CPU with any benchmark that blocks or yields, which shows up in the median
+ * and max rather than the min.
+ */
+
+uint32_t sysbenchSample[ SYSBENCH_REPS ];
+
+char sysbenchMsg[ SYSBENCH_MAX_MSG ];
+char sysbenchBlock[ SYSBENCH_MAX_BLOCK ];
+
+void sysbench_puts( char* x ) {
+  fputs( x, stdout );
+}
+
+// report the n samples, i.e., the cycles taken per operation, and mean time ns per operation
+
+void sysbench_report( char* f, int param, int n, uint64_t ns ) {
+  uint32_t* x = sysbenchSample;
+
+  for( int i = 1; i < n; i++ ) { // insertion sort, since n is small
+    uint32_t t = x[ i ]; int j = i;
+
+    for( ; ( j > 0 ) && ( x[ j - 1 ] > t ); j-- ) {
+      x[ j ] = x[ j - 1 ];
+    }
+
+    x[ j ] = t;
+  }
+
+  printf( "%s %d %d %u %u %u %llu\n", f, param, n, x[ 0 ], x[ n / 2 ], x[ n - 1 ], ns / n );
+}
+
+/* Pipes are small, and a write to a full pipe returns having written fewer
+ * bytes than requested, so these send and receive exactly n bytes.
+ */
+
+int sysbench_send( int fd, char* x, int n ) {
+  while( n > 0 ) {
+    int r = write( fd, x, n );
+
+    if( r < 0 ) {
+      return -1;
+    }
+    else if( r == 0 ) {
+      yield();
+    }
+
+    x += r; n -= r;
+  }
+
+  return 0;
+}
+
+int sysbench_recv( int fd, char* x, int n ) {
+  while( n > 0 ) {
+    int r = read_timed( fd, x, n, TIMEOUT_INFINITE );
+
+    if( r < 0 ) {
+      return -1;
+    }
+
+    x += r; n -= r;
+  }
+
+  return 0;
+}
+
+void sysbench_null() {
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS; i++ ) {
+    uint32_t t = cycle_count(); getpid(); t = cycle_count() - t;
+
+    sysbenchSample[ i ] = t;
+  }
+
+  sysbench_report( "null", 1, SYSBENCH_REPS, clock_ns() - ns );
+}
+
+// the time for the executing process to be resumed after yielding, i.e., two context switches if only the benchmark is ready
+
+void sysbench_yield() {
+  pid_t pid = fork();
+
+  if( pid == 0 ) {
+    while( 1 ) {
+      yield();
+    }
+  }
+
+  yield(); // let the child start
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS; i++ ) {
+    uint32_t t = cycle_count(); yield(); t = cycle_count() - t;
+
+    sysbenchSample[ i ] = t;
+  }
+
+  ns = clock_ns() - ns;
+
+  kill( pid, SIG_TERM );
+
+  sysbench_report( "yield", 2, SYSBENCH_REPS, ns );
+}
+
+// the time for an n-byte message to be echoed by another process
+
+void sysbench_pipe_rtt( int n ) {
+  int x[ 2 ], y[ 2 ];
+
+  if( ( pipe( x ) < 0 ) || ( pipe( y ) < 0 ) ) {
+    sysbench_puts( "#pipe failed\n" ); return;
+  }
+
+  pid_t pid = fork();
+
+  if( pid == 0 ) {
+    while( 0 == sysbench_recv( x[ 0 ], sysbenchMsg, n ) ) {
+      sysbench_send( y[ 1 ], sysbenchMsg, n );
+    }
+
+    exit( EXIT_FAILURE );
+  }
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS; i++ ) {
+    uint32_t t = cycle_count();
+
+    sysbench_send( x[ 1 ], sysbenchMsg, n );
+    sysbench_recv( y[ 0 ], sysbenchMsg, n );
+
+    sysbenchSample[ i ] = cycle_count() - t;
+  }
+
+  ns = clock_ns() - ns;
+
+  kill( pid, SIG_TERM );
+
+  close( x[ 0 ] ); close( x[ 1 ] );
+  close( y[ 0 ] ); close( y[ 1 ] );
+
+  sysbench_report( "pipe_rtt", n, SYSBENCH_REPS, ns );
+}
+
+// the time per n-byte message to stream SYSBENCH_STREAM bytes to another process, which acknowledges the last
+
+void sysbench_pipe_stream( int n ) {
+  int x[ 2 ], y[ 2 ], m = SYSBENCH_STREAM / n;
+
+  if( ( pipe( x ) < 0 ) || ( pipe( y ) < 0 ) ) {
+    sysbench_puts( "#pipe failed\n" ); return;
+  }
+
+  pid_t pid = fork();
+
+  if( pid == 0 ) {
+    while( 1 ) {
+      for( int j = 0; j < m; j++ ) {
+        if( sysbench_recv( x[ 0 ], sysbenchMsg, n ) < 0 ) {
+          exit( EXIT_FAILURE );
+        }
+      }
+
+      sysbench_send( y[ 1 ], sysbenchMsg, 1 );
+    }
+  }
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS_SLOW; i++ ) {
+    uint32_t t = cycle_count();
+
+    for( int j = 0; j < m; j++ ) {
+      sysbench_send( x[ 1 ], sysbenchMsg, n );
+    }
+
+    sysbench_recv( y[ 0 ], sysbenchMsg, 1 );
+
+    sysbenchSample[ i ] = ( cycle_count() - t ) / m;
+  }
+
+  ns = ( clock_ns() - ns ) / m;
+
+  kill( pid, SIG_TERM );
+
+  close( x[ 0 ] ); close( x[ 1 ] );
+  close( y[ 0 ] ); close( y[ 1 ] );
+
+  sysbench_report( "pipe_stream", n, SYSBENCH_REPS_SLOW, ns );
+}
+
+/* The time for a real-time (SCHED_FIFO) process blocked reading a pipe to
+ * execute once a CPU-bound normal process writes to it, i.e., the wakeup to
+ * run latency.  The samples are 24MHz counter (rather than PMU) cycles, since
+ * the writer may execute on another CPU.
+ */
+
+void sysbench_rt_wake() {
+  int x[ 2 ];
+
+  if( pipe( x ) < 0 ) {
+    sysbench_puts( "#pipe failed\n" ); return;
+  }
+  if( sched_setscheduler( getpid(), SCHED_FIFO, 1 ) < 0 ) {
+    sysbench_puts( "#sched_setscheduler failed\n" ); return;
+  }
+
+  pid_t pid = fork();
+
+  if( pid == 0 ) {
+    sched_setscheduler( getpid(), SCHED_NORMAL, 0 );
+
+    while( 1 ) {
+      uint64_t t = clock_cycles();
+
+      sysbench_send( x[ 1 ], ( char* )( &t ), sizeof( uint64_t ) );
+
+      while( ( clock_cycles() - t ) < ( vdso.freq / 1000 ) ) {
+        // spin for 1ms, so the reader blocks again before the next write
+      }
+    }
+  }
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS; i++ ) {
+    uint64_t t;
+
+    sysbench_recv( x[ 0 ], ( char* )( &t ), sizeof( uint64_t ) );
+
+    sysbenchSample[ i ] = clock_cycles() - t;
+  }
+
+  ns = clock_ns() - ns;
+
+  kill( pid, SIG_TERM );
+  sched_setscheduler( getpid(), SCHED_NORMAL, 0 );
+
+  close( x[ 0 ] ); close( x[ 1 ] );
+
+  sysbench_report( "rt_wake", 2, SYSBENCH_REPS, ns );
+}
+
+// the time from fork until the child has terminated, as observed by the parent
+
+void sysbench_fork() {
+  proc_stats_t s;
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS_SLOW; i++ ) {
+    uint32_t t = cycle_count();
+
+    pid_t pid = fork();
+
+    if( pid == 0 ) {
+      exit( EXIT_SUCCESS );
+    }
+    else if( pid < 0 ) {
+      sysbench_puts( "#fork failed\n" ); return;
+    }
+
+    while( proc_stats( pid, &s ) != PROC_TERMINATED ) {
+      yield();
+    }
+
+    sysbenchSample[ i ] = cycle_count() - t;
+  }
+
+  sysbench_report( "fork_exit", 1, SYSBENCH_REPS_SLOW, clock_ns() - ns );
+}
+
+// the time to read block 0, then to write it back unchanged (so the disk content is preserved), where the write is buffered, then to do so and wait for it to complete
+
+void sysbench_disk() {
+  int n = disk( DISK_OP_LEN, 0, NULL );
+
+  if( ( n <= 0 ) || ( n > SYSBENCH_MAX_BLOCK ) ) {
+    sysbench_puts( "#disk unavailable\n" ); return;
+  }
+
+  uint64_t ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS_SLOW; i++ ) {
+    uint32_t t = cycle_count(); int r = disk( DISK_OP_READ,  0, sysbenchBlock ); t = cycle_count() - t;
+
+    if( r < 0 ) {
+      sysbench_puts( "#disk failed\n" ); return;
+    }
+
+    sysbenchSample[ i ] = t;
+  }
+
+  sysbench_report( "disk_rd", n, SYSBENCH_REPS_SLOW, clock_ns() - ns );
+
+  ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS_SLOW; i++ ) {
+    uint32_t t = cycle_count(); int r = disk( DISK_OP_WRITE, 0, sysbenchBlock ); t = cycle_count() - t;
+
+    if( r < 0 ) {
+      sysbench_puts( "#disk failed\n" ); return;
+    }
+
+    sysbenchSample[ i ] = t;
+  }
+
+  sysbench_report( "disk_wr", n, SYSBENCH_REPS_SLOW, clock_ns() - ns );
+
+  ns = clock_ns();
+
+  for( int i = 0; i < SYSBENCH_REPS_SLOW; i++ ) {
+    uint32_t t = cycle_count(); int r = disk( DISK_OP_WRITE, 0, sysbenchBlock ); r |= disk( DISK_OP_SYNC, 0, NULL ); t = cycle_count() - t;
+
+    if( r < 0 ) {
+      sysbench_puts( "#disk failed\n" ); return;
+    }
+
+    sysbenchSample[ i ] = t;
+  }
+
+  sysbench_report( "disk_sync", n, SYSBENCH_REPS_SLOW, clock_ns() - ns );
+}
+
+void main_sysbench() {
+  int sizes[] = { 1, 8, 64, SYSBENCH_MAX_MSG };
+
+  sysbench_puts( "#sysbench\n" );
+
+  sysbench_null();
+  sysbench_yield();
+
+  for( int i = 0; i < sizeof( sizes ) / sizeof( int ); i++ ) {
+    sysbench_pipe_rtt( sizes[ i ] );
+  }
+  for( int i = 0; i < sizeof( sizes ) / sizeof( int ); i++ ) {
+    sysbench_pipe_stream( sizes[ i ] );
+  }
+
+  sysbench_rt_wake();
+  sysbench_fork();
+  sysbench_disk();
+
+  sysbench_puts( "#end\n" );
+
+  exit( EXIT_SUCCESS );
+}
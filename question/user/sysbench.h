@@ -0,0 +1,25 @@
+/* Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+ *
+ * Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+ * which can be found via http://creativecommons.org (and should be included as
+ * LICENSE.txt within the associated archive or repository).
+ */
+
+#ifndef __SYSBENCH_H
+#define __SYSBENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "libc.h"
+
+#define SYSBENCH_REPS      (  64 ) // repetitions per measurement
+#define SYSBENCH_REPS_SLOW (   8 ) // ditto, for measurements taking milliseconds
+#define SYSBENCH_STREAM    ( 512 ) // bytes streamed per pipe throughput repetition
+#define SYSBENCH_MAX_MSG   ( 256 )
+#define SYSBENCH_MAX_BLOCK ( 512 )
+
+#endif
@@ -0,0 +1,194 @@
+# Copyright (C) 2017 Daniel Page <csdsp@bristol.ac.uk>
+#
+# Use of this source code is restricted per the CC BY-NC-ND license, a copy of
+# which can be found via http://creativecommons.org (and should be included as
+# LICENSE.txt within the associated archive or repository).
+
+import argparse, datetime, json, math, os, select, socket, subprocess, sys, time
+
+# QEMU is launched headless, without waiting for GDB: UART0 is its stdout,
+# and UART1 (the console) and UART2 (the disk) are TCP servers, which the
+# harness and the disk stand-in (i.e., disk.py) connect to respectively.
+
+def launch_qemu( args ) :
+  cmd  = [ args.qemu, '-nodefaults', '-M', args.board, '-smp', str( args.cpus ), '-m', '512M', '-nographic', '-display', 'none' ]
+  cmd += [ '-serial', 'stdio' ]
+  cmd += [ '-serial', 'tcp:%s:%d,server=on,wait=off' % ( args.host, args.console_port ) ]
+  cmd += [ '-serial', 'tcp:%s:%d,server=on,wait=off' % ( args.host, args.disk_port    ) ]
+  cmd += [ '-kernel', args.image ]
+
+  return subprocess.Popen( cmd, stdin = subprocess.DEVNULL, stdout = subprocess.PIPE )
+
+# Once the console port accepts a connection, all of the serial ports exist,
+# so the disk stand-in can connect.
+
+def connect( host, port, timeout ) :
+  limit = time.time() + timeout
+
+  while ( True ) :
+    try :
+      return socket.create_connection( ( host, port ) )
+    except OSError :
+      if ( time.time() > limit ) :
+        raise
+
+      time.sleep( 0.1 )
+
+def launch_disk( args ) :
+  if ( not os.path.exists( args.disk_file ) ) :
+    with open( args.disk_file, 'wb' ) as fd :
+      fd.truncate( args.block_num * args.block_len )
+
+  cmd  = [ args.disk_python, args.disk_script, '--host=%s' % ( args.host ), '--port=%d' % ( args.disk_port ), '--file=%s' % ( args.disk_file ) ]
+  cmd += [ '--block-num=%d' % ( args.block_num ), '--block-len=%d' % ( args.block_len ) ]
+
+  return subprocess.Popen( cmd, stdin = subprocess.DEVNULL, stdout = subprocess.DEVNULL, stderr = subprocess.DEVNULL )
+
+# Results are written by the sysbench program as a block of lines, delimited
+# by #sysbench and #end, which may be interleaved with other output (e.g., a
+# kernel trace): each result line has a name then 6 integers (see sysbench.c).
+
+FIELDS = [ 'param', 'reps', 'min', 'median', 'max', 'ns' ]
+
+def collect( qemu, log, timeout ) :
+  results = [] ; notes = [] ; started = False ; buf = b'' ; limit = time.time() + timeout
+
+  while ( time.time() < limit ) :
+    r, _, _ = select.select( [ qemu.stdout ], [], [], 1.0 )
+
+    if ( not r ) :
+      continue
+
+    data = os.read( qemu.stdout.fileno(), 4096 )
+
+    if ( not data ) :
+      break
+    if ( log != None ) :
+      log.write( data )
+
+    buf += data
+
+    while ( b'\n' in buf ) :
+      line, buf = buf.split( b'\n', 1 ) ; t = line.decode( 'ascii', 'replace' ).strip().split( ' ' )
+
+      if   ( t[ 0 ] == '#sysbench' ) :
+        started = True
+      elif ( not started ) :
+        continue
+      elif ( t[ 0 ] == '#end'      ) :
+        return ( results, notes, True )
+      elif ( t[ 0 ].startswith( '#' ) ) :
+        notes.append( ' '.join( t )[ 1 : ] )
+      elif ( len( t ) == 1 + len( FIELDS ) and all( x.isdigit() for x in t[ 1 : ] ) ) :
+        result = { 'name' : t[ 0 ] }
+        result.update( zip( FIELDS, [ int( x ) for x in t[ 1 : ] ] ) )
+        results.append( result )
+
+  return ( results, notes, False )
+
+# Thresholds map <name>/<param> to the maximum acceptable median (in cycles);
+# a result with no threshold always passes.
+
+def check( results, thresholds ) :
+  ok = True
+
+  for result in results :
+    k = '%s/%d' % ( result[ 'name' ], result[ 'param' ] )
+
+    result[ 'threshold' ] = thresholds.get( k )
+    result[ 'pass'      ] = ( result[ 'threshold' ] == None ) or ( result[ 'median' ] <= result[ 'threshold' ] )
+
+    ok = ok and result[ 'pass' ]
+
+  return ok
+
+if ( __name__ == '__main__' ) :
+  # parse command line arguments
+
+  parser = argparse.ArgumentParser()
+
+  parser.add_argument( '--qemu',         type =   str, action = 'store', default = 'qemu-system-arm' )
+  parser.add_argument( '--board',        type =   str, action = 'store', default = 'realview-pb-a8' )
+  parser.add_argument( '--cpus',         type =   int, action = 'store', default = 1 )
+  parser.add_argument( '--image',        type =   str, action = 'store', default = 'image.bin' )
+
+  parser.add_argument( '--host',         type =   str, action = 'store', default = '127.0.0.1' )
+  parser.add_argument( '--console-port', type =   int, action = 'store', default = 1235 )
+  parser.add_argument( '--disk-port',    type =   int, action = 'store', default = 1236 )
+
+  parser.add_argument( '--disk-python',  type =   str, action = 'store', default = 'python' )
+  parser.add_argument( '--disk-script',  type =   str, action = 'store', default = 'device/disk.py' )
+  parser.add_argument( '--disk-file',    type =   str, action = 'store', default = 'disk.bin' )
+  parser.add_argument( '--block-num',    type =   int, action = 'store', default = 65536 )
+  parser.add_argument( '--block-len',    type =   int, action = 'store', default = 16 )
+
+  parser.add_argument( '--command',      type =   str, action = 'append' )
+  parser.add_argument( '--timeout',      type = float, action = 'store', default = 600 )
+  parser.add_argument( '--log',          type =   str, action = 'store' )
+
+  parser.add_argument( '--report',       type =   str, action = 'store', default = 'bench.json' )
+  parser.add_argument( '--thresholds',   type =   str, action = 'store' )
+  parser.add_argument( '--baseline',     type = float, action = 'store', help = 'write thresholds of this multiple of each median' )
+
+  args = parser.parse_args()
+
+  commands = args.command if ( args.command != None ) else [ 'execute Sb' ]
+
+  log  = open( args.log, 'wb' ) if ( args.log != None ) else None
+
+  qemu = launch_qemu( args ) ; disk = None
+
+  try :
+    console = connect( args.host, args.console_port, 10 )
+    disk    = launch_disk( args )
+
+    # the console reads a line at a time, so commands can be sent at once: they queue in the UART (or socket) until read
+
+    for command in commands :
+      console.sendall( ( command + '\n' ).encode( 'ascii' ) )
+
+    results, notes, complete = collect( qemu, log, args.timeout )
+  finally :
+    qemu.kill() ; qemu.wait()
+
+    if ( disk != None ) :
+      disk.kill() ; disk.wait()
+    if ( log  != None ) :
+      log.close()
+
+  # check results against thresholds, then write report
+
+  thresholds = {}
+
+  if ( args.thresholds != None and os.path.exists( args.thresholds ) and args.baseline == None ) :
+    with open( args.thresholds, 'r' ) as fd :
+      thresholds = json.load( fd )
+
+  ok = check( results, thresholds ) and complete and ( len( results ) > 0 )
+
+  report = { 'date'     : datetime.datetime.now().isoformat(),
+             'board'    : args.board,
+             'cpus'     : args.cpus,
+             'image'    : args.image,
+             'commands' : commands,
+             'complete' : complete,
+             'notes'    : notes,
+             'results'  : results,
+             'pass'     : ok }
+
+  with open( args.report, 'w' ) as fd :
+    json.dump( report, fd, indent = 2 )
+
+  if ( args.baseline != None and args.thresholds != None and complete ) :
+    with open( args.thresholds, 'w' ) as fd :
+      json.dump( { '%s/%d' % ( r[ 'name' ], r[ 'param' ] ) : int( math.ceil( r[ 'median' ] * args.baseline ) ) for r in results }, fd, indent = 2, sort_keys = True )
+
+  for result in results :
+    print( '%-12s %5d %10d %10d %10d %12d  %s' % ( result[ 'name' ], result[ 'param' ], result[ 'min' ], result[ 'median' ], result[ 'max' ], result[ 'ns' ], 'ok' if ( result[ 'pass' ] ) else 'FAIL > %d' % ( result[ 'threshold' ] ) ) )
+  for note in notes :
+    print( note )
+
+  if ( not complete ) :
+    print( 'incomplete: no #end within %g seconds' % ( args.timeout ) )
+
+  sys.exit( 0 if ( ok ) else 1 )